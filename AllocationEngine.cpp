@@ -1,62 +1,224 @@
 #include "AllocationEngine.h"
 #include <iostream>
 
-AllocationResult AllocationEngine::allocateSlot(int requestedZoneId, std::vector<Zone>& zones) {
-    AllocationResult result = {false, -1, -1, false};
-    Zone* targetZone = nullptr;
+AllocationStrategy AllocationEngine::strategy = AllocationStrategy::BITMAP;
+int AllocationEngine::maxCrossZoneHops = 3;
 
-    // 1. Find the requested zone object
-    for (auto& z : zones) {
-        if (z.getZoneId() == requestedZoneId) {
-            targetZone = &z;
+void AllocationEngine::setStrategy(AllocationStrategy s) {
+    strategy = s;
+}
+
+AllocationStrategy AllocationEngine::getStrategy() {
+    return strategy;
+}
+
+void AllocationEngine::setMaxCrossZoneHops(int hops) {
+    maxCrossZoneHops = hops;
+}
+
+int AllocationEngine::getMaxCrossZoneHops() {
+    return maxCrossZoneHops;
+}
+
+int AllocationEngine::findNearestFreeZone(CityLayout& city, int zoneIndex, int& hops) {
+    // Hot path: the cache only goes stale when a zone within reach crosses zero free slots
+    int target;
+    if (city.getCachedNearestFree(zoneIndex, target, hops)) {
+        if (target != -1 && hops <= maxCrossZoneHops) return target;
+        if (target == -1 && hops >= maxCrossZoneHops) return -1; // Already searched at least this deep
+    }
+    // Stamped before searching, so a zone filling or freeing mid-search leaves the stored answer stale
+    NearestFreeStamp stamp = city.stampNearestFree(zoneIndex, maxCrossZoneHops);
+
+    // Hop-limited BFS. Neighbours are visited in adjacency order, so with a limit of 1
+    // this picks the same zone as the old direct-neighbour loop. Scratch buffers are reused per thread.
+    thread_local std::vector<int> depth;
+    thread_local std::vector<int> frontier;
+    if (depth.size() < (size_t)city.getZoneCount()) depth.resize(city.getZoneCount(), -1);
+    frontier.assign(1, zoneIndex);
+    depth[zoneIndex] = 0;
+    int found = -1;
+    hops = maxCrossZoneHops;
+    for (size_t i = 0; i < frontier.size(); ++i) {
+        int z = frontier[i];
+        if (depth[z] > 0 && city.getZoneOccupied(z) < city.getZoneCapacity(z)) {
+            found = z;
+            hops = depth[z];
             break;
         }
+        if (depth[z] == maxCrossZoneHops) continue;
+        for (int neighborId : city.getAdjacentZones(z)) {
+            int n = city.findZoneIndex(neighborId);
+            if (n == -1 || depth[n] != -1) continue; // Dangling adjacency or already queued
+            depth[n] = depth[z] + 1;
+            frontier.push_back(n);
+        }
     }
+    for (int z : frontier) depth[z] = -1;
 
-    if (!targetZone) {
-        // Requested zone does not exist
-        return result; 
-    }
+    city.setCachedNearestFree(zoneIndex, found, hops, stamp);
+    return found;
+}
+
+int AllocationEngine::allocateInZone(CityLayout& city, int zoneIndex) {
+    Zone zone(&city, zoneIndex);
+    if (zone.isFull()) return -1; // O(1) skip via the live counters
 
-    // 2. Try to find slot in requested zone
-    for (auto& area : targetZone->getParkingAreasMutable()) {
-        for (auto& slot : area.getSlotsMutable()) {
-            if (!slot.isOccupied()) {
-                slot.occupy(); // Mark as occupied temporarily (reservation) or caller does it?
-                               // Ideally Engine just finds it, but usually allocation "reserves" it.
-                               // Requirement: "Allocate parking slots". Let's mark it here.
-                result.success = true;
-                result.slotId = slot.getSlotId();
-                result.zoneId = requestedZoneId;
-                return result;
+    for (ParkingArea area : zone.getParkingAreas()) {
+        if (city.isLockFreeClaiming() && strategy != AllocationStrategy::LINEAR_SCAN) {
+            // No zone lock held: claim with a CAS on the bitmap word instead of find-then-occupy
+            if (area.isFull()) continue;
+            int index = city.claimFreeSlot(area.getIndex());
+            if (index != -1) return city.getSlotId(index);
+        } else if (strategy != AllocationStrategy::LINEAR_SCAN) {
+            if (area.isFull()) continue;
+            int index = (strategy == AllocationStrategy::BITMAP) ? area.findFreeSlotIndex() : area.peekFreeList();
+            if (index != -1) {
+                ParkingSlot slot(&city, index);
+                slot.occupy(); // Reserve it; occupy() also sets the bitmap bit and pops the free list
+                return slot.getSlotId();
+            }
+        } else {
+            for (ParkingSlot slot : area.getSlots()) {
+                if (!slot.isOccupied() && slot.occupy()) { // occupy() reserves it, failing if another thread got there first
+                    return slot.getSlotId();
+                }
             }
         }
     }
+    return -1;
+}
 
-    // 3. If full, check neighbors (Cross-zone)
-    // Constraint: "Cross-zone allocation ... incurs extra cost/penalty" 
-    // We just find a slot here.
-    const std::vector<int>& neighbors = targetZone->getAdjacentZones();
-    for (int neighborId : neighbors) {
-        for (auto& z : zones) {
-            if (z.getZoneId() == neighborId) {
-                // Search this neighbor
-                for (auto& area : z.getParkingAreasMutable()) {
-                    for (auto& slot : area.getSlotsMutable()) {
-                        if (!slot.isOccupied()) {
-                            slot.occupy();
-                            result.success = true;
-                            result.slotId = slot.getSlotId();
-                            result.zoneId = neighborId;
-                            result.isCrossZone = true;
-                            return result;
-                        }
-                    }
+int AllocationEngine::allocateManyInZone(CityLayout& city, int zoneIndex, int count, std::vector<int>& slotIds) {
+    Zone zone(&city, zoneIndex);
+    int taken = 0;
+    for (ParkingArea area : zone.getParkingAreas()) {
+        if (taken == count || zone.isFull()) break;
+        if (strategy == AllocationStrategy::LINEAR_SCAN) {
+            for (ParkingSlot slot : area.getSlots()) {
+                if (taken == count) break;
+                if (!slot.isOccupied() && slot.occupy()) {
+                    slotIds.push_back(slot.getSlotId());
+                    taken++;
+                }
+            }
+        } else {
+            int from = -1; // Bitmap cursor: everything before it is already taken
+            while (taken < count && !area.isFull()) {
+                int index;
+                if (city.isLockFreeClaiming()) {
+                    index = city.claimFreeSlot(area.getIndex(), from);
+                } else {
+                    index = (strategy == AllocationStrategy::BITMAP) ? city.findFreeSlot(area.getIndex(), from) : area.peekFreeList();
+                    if (index != -1) city.occupySlot(index);
                 }
+                if (index == -1) break;
+                slotIds.push_back(city.getSlotId(index));
+                from = index + 1;
+                taken++;
             }
         }
     }
+    return taken;
+}
+
+AllocationResult AllocationEngine::allocateSlot(int requestedZoneId, CityLayout& city) {
+    AllocationResult result = {false, -1, -1, false, 0};
+
+    // 1. Find the requested zone object
+    int zoneIndex = city.findZoneIndex(requestedZoneId);
+    if (zoneIndex == -1) {
+        // Requested zone does not exist
+        return result; 
+    }
+
+    int slotId = -1;
+    int hops = 0;
+    int nearest = -1;
+    bool lockFree = city.isLockFreeClaiming(); // Slots are claimed by CAS, zone locks only guard the nearest-free cache
+    {
+        ZoneGuard guard(city, lockFree ? -1 : zoneIndex);
+
+        // 2. Try to find slot in requested zone
+        slotId = allocateInZone(city, zoneIndex);
+        if (slotId != -1) {
+            result.success = true;
+            result.slotId = slotId;
+            result.zoneId = requestedZoneId;
+            return result;
+        }
+        ZoneGuard cacheGuard(city, lockFree ? zoneIndex : -1);
+
+        // 3. If full, go to the nearest zone with space, up to maxCrossZoneHops away (Cross-zone)
+        // Constraint: "Cross-zone allocation ... incurs extra cost/penalty" 
+        // We just find a slot here.
+        nearest = findNearestFreeZone(city, zoneIndex, hops);
+        if (nearest == -1) return result;
+    }
+
+    // Re-lock both zones in ascending index order (deadlock-free when locking is on).
+    // A slot may have been released in the requested zone meanwhile, so check it again first.
+    ZoneGuard guard(city, lockFree ? -1 : zoneIndex, lockFree ? -1 : nearest);
+    slotId = allocateInZone(city, zoneIndex);
+    if (slotId != -1) {
+        result.success = true;
+        result.slotId = slotId;
+        result.zoneId = requestedZoneId;
+        return result;
+    }
+    slotId = allocateInZone(city, nearest);
+    if (slotId != -1) {
+        result.success = true;
+        result.slotId = slotId;
+        result.zoneId = city.getZoneId(nearest);
+        result.isCrossZone = true;
+        result.hops = hops;
+        return result;
+    }
 
-    // 4. Failed to allocate
+    // 4. Failed to allocate (or lost the race for the nearest zone's last slot)
     return result;
 }
+
+void AllocationEngine::allocateBatch(int requestedZoneId, int count, CityLayout& city, std::vector<AllocationResult>& out) {
+    AllocationResult failed = {false, -1, -1, false, 0};
+    int zoneIndex = city.findZoneIndex(requestedZoneId);
+    if (zoneIndex == -1) {
+        out.insert(out.end(), count, failed);
+        return;
+    }
+
+    std::vector<int> slotIds;
+    slotIds.reserve(count);
+    int taken = 0;
+    {
+        ZoneGuard guard(city, zoneIndex);
+        taken = allocateManyInZone(city, zoneIndex, count, slotIds);
+    }
+    for (int i = 0; i < taken; ++i) {
+        out.push_back({true, slotIds[i], requestedZoneId, false, 0});
+    }
+
+    // Spill the rest into the nearest zones with space; each one is filled before moving on
+    int remaining = count - taken;
+    while (remaining > 0) {
+        int hops = 0;
+        int nearest = -1;
+        {
+            ZoneGuard guard(city, zoneIndex); // The nearest-free cache belongs to the requested zone
+            nearest = findNearestFreeZone(city, zoneIndex, hops);
+        }
+        if (nearest == -1) break;
+        slotIds.clear();
+        {
+            ZoneGuard guard(city, nearest);
+            taken = allocateManyInZone(city, nearest, remaining, slotIds);
+        }
+        if (taken == 0) break;
+        for (int i = 0; i < taken; ++i) {
+            out.push_back({true, slotIds[i], city.getZoneId(nearest), true, hops});
+        }
+        remaining -= taken;
+    }
+    out.insert(out.end(), remaining, failed);
+}
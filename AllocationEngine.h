@@ -2,6 +2,7 @@
 #define ALLOCATION_ENGINE_H
 
 #include <vector>
+#include "CityLayout.h"
 #include "Zone.h"
 #include "ParkingSlot.h"
 
@@ -10,13 +11,48 @@ struct AllocationResult {
     int slotId;
     int zoneId; // Could be different from requested if cross-zone
     bool isCrossZone;
+    int hops; // Zone-graph distance from the requested zone (0 = same zone)
+};
+
+// How a free slot is located inside a zone
+enum class AllocationStrategy {
+    LINEAR_SCAN, // Walk every slot calling isOccupied() (original first-fit, kept for benchmarking)
+    BITMAP,      // Find-first-zero over each area's 64-bit occupancy words
+    FREE_LIST    // Pop the area's LIFO free list, O(1) regardless of size or fill level
 };
 
 class AllocationEngine {
+private:
+    static AllocationStrategy strategy;
+    static int maxCrossZoneHops;
+
+    // Occupies the first free slot of the zone, returns its ID or -1 if the zone is full
+    static int allocateInZone(CityLayout& city, int zoneIndex);
+
+    // Occupies up to `count` free slots of the zone in one pass over its areas, appending their IDs.
+    // Returns how many were taken.
+    static int allocateManyInZone(CityLayout& city, int zoneIndex, int count, std::vector<int>& slotIds);
+
+    // Closest zone (by hops, BFS over adjacency) with free capacity, served from the city's
+    // nearest-free cache when it is still valid. Returns the zone index or -1.
+    static int findNearestFreeZone(CityLayout& city, int zoneIndex, int& hops);
+
 public:
-    // Tries to allocate a slot for the given zone preference in the list of all Zones
+    // Tries to allocate a slot for the given zone preference in the city
     // Returns AllocationResult
-    static AllocationResult allocateSlot(int requestedZoneId, std::vector<Zone>& zones);
+    static AllocationResult allocateSlot(int requestedZoneId, CityLayout& city);
+
+    // Allocates `count` requests for one zone: the zone is resolved once and filled in a single
+    // pass, and whatever it cannot hold goes to the nearest zones with space.
+    // Appends exactly `count` results to `out`.
+    static void allocateBatch(int requestedZoneId, int count, CityLayout& city, std::vector<AllocationResult>& out);
+
+    static void setStrategy(AllocationStrategy s);
+    static AllocationStrategy getStrategy();
+
+    // How far the cross-zone fallback may search (1 = direct neighbours only)
+    static void setMaxCrossZoneHops(int hops);
+    static int getMaxCrossZoneHops();
 };
 
 #endif // ALLOCATION_ENGINE_H
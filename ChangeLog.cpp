@@ -0,0 +1,46 @@
+#include "ChangeLog.h"
+#include <algorithm>
+
+ChangeLog::ChangeLog(size_t capacity) : ring(capacity > 0 ? capacity : 1), next(0), count(0), horizon(0) {}
+
+void ChangeLog::push(unsigned long version, int index, bool isSlot) {
+    if (count == ring.size()) {
+        horizon = std::max(horizon, ring[next].version - 1); // Overwriting the oldest entry
+    } else {
+        count++;
+    }
+    ring[next] = Entry{version, index, isSlot};
+    next = (next + 1) % ring.size();
+}
+
+void ChangeLog::record(unsigned long version, const std::vector<int>& slots, const std::vector<int>& requests) {
+    std::lock_guard<std::mutex> guard(lock.m);
+    for (int s : slots) push(version, s, true);
+    for (int r : requests) push(version, r, false);
+}
+
+void ChangeLog::reset(unsigned long version) {
+    std::lock_guard<std::mutex> guard(lock.m);
+    horizon = std::max(horizon, version);
+}
+
+bool ChangeLog::collect(unsigned long since, unsigned long upTo, std::vector<int>& slots, std::vector<int>& requests) {
+    slots.clear();
+    requests.clear();
+    {
+        std::lock_guard<std::mutex> guard(lock.m);
+        if (since <= horizon || since > upTo) return false;
+        // Newest first, stopping at the first entry the client already has
+        for (size_t i = 0; i < count; ++i) {
+            const Entry& e = ring[(next + ring.size() - 1 - i) % ring.size()];
+            if (e.version <= since) break;
+            if (e.version > upTo) continue; // Published after the caller's snapshot
+            (e.isSlot ? slots : requests).push_back(e.index);
+        }
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    std::sort(requests.begin(), requests.end());
+    requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+    return true;
+}
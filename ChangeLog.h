@@ -0,0 +1,40 @@
+#ifndef CHANGE_LOG_H
+#define CHANGE_LOG_H
+
+#include <vector>
+#include <cstddef>
+#include "Concurrency.h"
+
+// Bounded record of what each published snapshot version changed, for delta sync
+// (see ParkingSystem::getChangesSince). Each entry stamps one slot index or request position
+// with the version that changed it. Once entries are evicted, clients older than them get a full resync.
+class ChangeLog {
+private:
+    struct Entry {
+        unsigned long version;
+        int index;
+        bool isSlot; // Slot index, else request position
+    };
+
+    std::vector<Entry> ring;
+    size_t next;
+    size_t count;
+    unsigned long horizon; // Clients at or before this version must resync (0 is never a real version)
+    CopyableMutex lock;
+
+    void push(unsigned long version, int index, bool isSlot);
+
+public:
+    static const size_t DEFAULT_CAPACITY = 65536;
+
+    explicit ChangeLog(size_t capacity = DEFAULT_CAPACITY);
+
+    void record(unsigned long version, const std::vector<int>& slots, const std::vector<int>& requests);
+    void reset(unsigned long version); // Clients at or before `version` must resync (e.g. the city grew)
+
+    // Distinct slots and requests changed in versions (since, upTo], ascending.
+    // False if that range is no longer fully covered.
+    bool collect(unsigned long since, unsigned long upTo, std::vector<int>& slots, std::vector<int>& requests);
+};
+
+#endif // CHANGE_LOG_H
@@ -0,0 +1,33 @@
+#include "Checkpointer.h"
+#include <chrono>
+
+Checkpointer::Checkpointer(ParkingSystem& ps, const std::string& path, int ms)
+    : system(ps), imagePath(path), intervalMs(ms), savedMutations(ps.getMutationCount()), stopping(false) {
+    system.enableConcurrency(); // Checkpoints are now cut from another thread
+    worker = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(stopLock);
+        stopping = true;
+    }
+    stopSignal.notify_one();
+    worker.join();
+}
+
+void Checkpointer::checkpoint() {
+    system.archiveRequests(); // Requests age even in a quiet city; archiving counts as a mutation
+    unsigned long mutations = system.getMutationCount();
+    if (mutations == savedMutations) return;
+    if (system.writeCheckpoint(imagePath)) savedMutations = mutations;
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> lock(stopLock);
+    while (true) {
+        bool stop = stopSignal.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return stopping; });
+        checkpoint();
+        if (stop) return;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef CHECKPOINTER_H
+#define CHECKPOINTER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ParkingSystem.h"
+
+// Writes a checkpoint image every intervalMs (skipping intervals with no mutations) and a final one
+// on shutdown, so restarts load the image and replay only a short log tail. Each round first applies
+// the retention policy (ParkingSystem::archiveRequests), so the image holds the compacted table.
+// Puts the system in concurrent mode.
+class Checkpointer {
+private:
+    ParkingSystem& system;
+    std::string imagePath;
+    int intervalMs;
+    unsigned long savedMutations; // Mutation count covered by the last image
+    bool stopping;
+    std::mutex stopLock;
+    std::condition_variable stopSignal;
+    std::thread worker;
+
+    void checkpoint();
+    void run();
+
+public:
+    Checkpointer(ParkingSystem& ps, const std::string& imagePath, int intervalMs);
+    ~Checkpointer(); // Stops the thread after a final checkpoint
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+};
+
+#endif // CHECKPOINTER_H
@@ -0,0 +1,97 @@
+#include "CityImage.h"
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<unsigned long> tempSequence(0);
+
+const char MAGIC[8] = {'P', 'K', 'I', 'M', 'G', '0', '0', '2'};
+
+std::uint64_t checksum(const char* data, size_t n) {
+    std::uint64_t h = 14695981039346656037ull; // FNV-1a, 64-bit
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool syncDirectoryOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+} // namespace
+
+CityImageWriter::CityImageWriter() : bytes(sizeof(CityImageHeader), 0) {}
+
+size_t CityImageWriter::size() const {
+    return bytes.size();
+}
+
+bool CityImageWriter::writeFile(const std::string& path, CityImageHeader header) {
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.payloadBytes = bytes.size() - sizeof(CityImageHeader);
+    header.checksum = checksum(bytes.data() + sizeof(CityImageHeader), header.payloadBytes);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    // Unique per process and call, so concurrent writers of one path (e.g. forked backups) never share a temp file
+    std::string temp = path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(tempSequence++);
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return false;
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    bool ok = done == bytes.size() && ::fsync(fd) == 0;
+    ::close(fd);
+    // The rename is the commit point: a crash before it leaves the previous image intact
+    if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) {
+        ::unlink(temp.c_str());
+        return false;
+    }
+    return syncDirectoryOf(path);
+}
+
+MappedCityImage::MappedCityImage(const std::string& path) : base(nullptr), length(0), cursor(sizeof(CityImageHeader)), valid(false) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CityImageHeader)) {
+        void* mapped = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            base = (char*)mapped;
+            length = (size_t)st.st_size;
+            ::madvise(base, length, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd); // The mapping stays valid
+
+    if (!base) return;
+    const CityImageHeader& header = getHeader();
+    valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.payloadBytes == length - sizeof(CityImageHeader) &&
+            header.checksum == checksum(base + sizeof(CityImageHeader), header.payloadBytes);
+}
+
+MappedCityImage::~MappedCityImage() {
+    if (base) ::munmap(base, length);
+}
+
+bool MappedCityImage::isValid() const {
+    return valid;
+}
+
+const CityImageHeader& MappedCityImage::getHeader() const {
+    return *reinterpret_cast<const CityImageHeader*>(base);
+}
@@ -0,0 +1,105 @@
+#ifndef CITY_IMAGE_H
+#define CITY_IMAGE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// On-disk checkpoint of a whole ParkingSystem (see ParkingSystem::writeCheckpoint).
+// A fixed header followed by raw native-endian columns, each padded to 8 bytes and in this order:
+// zone IDs, zone area offsets, adjacency offsets, adjacency, area IDs, area slot offsets, slot IDs,
+// occupancy words, RequestImage records, vehicle ID bytes, OperationImage records (oldest first),
+// cold archive blocks (see ColdArchive::encode).
+// The file is memory-mapped on restart and columns are copied into place without any parsing.
+struct CityImageHeader {
+    char magic[8];             // "PKIMG002"
+    std::uint64_t generation;  // First write-ahead log segment not covered by this image
+    std::uint64_t zoneCount;
+    std::uint64_t areaCount;
+    std::uint64_t slotCount;
+    std::uint64_t adjacencyCount;
+    std::uint64_t requestCount;
+    std::uint64_t vehicleBytes;
+    std::uint64_t operationCount;
+    std::uint64_t rollbackDepth;
+    std::uint64_t rollbackDropped;
+    std::uint64_t archiveBytes;
+    std::uint64_t archiveDropped;
+    std::uint64_t payloadBytes; // Everything after the header
+    std::uint64_t checksum;     // 64-bit FNV-1a of the payload
+};
+
+struct RequestImage {
+    std::int32_t requestId;
+    std::int32_t requestedZoneId;
+    std::int32_t state;
+    std::int32_t slotId;
+    std::int32_t zoneId;
+    std::uint32_t vehicleOffset; // Into the vehicle ID bytes
+    std::uint32_t vehicleLength;
+    std::uint32_t padding;
+    std::int64_t requestTime;
+    std::int64_t endTime;
+};
+
+struct OperationImage {
+    std::int32_t type;
+    std::int32_t requestId;
+    std::int32_t slotId;
+    std::int32_t zoneId;
+};
+
+// Builds an image in memory (cheap enough to do while writers are held back), then writes it
+// crash-safely: temp file, fsync, rename over the old image, fsync of the directory.
+class CityImageWriter {
+private:
+    std::vector<char> bytes; // Header space followed by the payload
+
+public:
+    CityImageWriter();
+
+    template <typename T>
+    void append(const T* data, size_t count) {
+        size_t size = sizeof(T) * count;
+        size_t at = bytes.size();
+        bytes.resize(at + ((size + 7) & ~size_t(7)), 0);
+        if (size > 0) std::memcpy(bytes.data() + at, data, size);
+    }
+
+    size_t size() const;
+    bool writeFile(const std::string& path, CityImageHeader header); // Fills magic, payloadBytes, checksum
+};
+
+// Read-only mapping of an image file. Columns are taken in file order with next().
+class MappedCityImage {
+private:
+    char* base;
+    size_t length;
+    size_t cursor;
+    bool valid;
+
+public:
+    explicit MappedCityImage(const std::string& path); // Maps and verifies; a missing file is just invalid
+    ~MappedCityImage();
+
+    MappedCityImage(const MappedCityImage&) = delete;
+    MappedCityImage& operator=(const MappedCityImage&) = delete;
+
+    bool isValid() const;
+    const CityImageHeader& getHeader() const;
+
+    // Next column of `count` elements, nullptr if the file is too short
+    template <typename T>
+    const T* next(size_t count) {
+        if (!valid || count > (length - cursor) / sizeof(T)) return nullptr;
+        size_t size = sizeof(T) * count;
+        size_t padded = (size + 7) & ~size_t(7);
+        if (cursor + padded > length) return nullptr;
+        const T* column = reinterpret_cast<const T*>(base + cursor);
+        cursor += padded;
+        return column;
+    }
+};
+
+#endif // CITY_IMAGE_H
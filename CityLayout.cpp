@@ -0,0 +1,417 @@
+#include "CityLayout.h"
+#include <utility>
+
+CityLayout::CityLayout() : topologyEpoch(0), nearestFreeRadius(0), zoneLocking(false), lockFreeClaiming(false) {
+    zoneAreaBegin.push_back(0);
+    areaSlotBegin.push_back(0);
+}
+
+int CityLayout::addZone(int zoneId) {
+    if (zoneIndexById.count(zoneId)) return -1;
+    int z = (int)zoneIds.size();
+    zoneIds.push_back(zoneId);
+    zoneAreaBegin.push_back((int)areaIds.size()); // New zone starts empty
+    zoneShards.emplace_back();
+    zoneAdjacency.emplace_back();
+    zoneReverseAdjacency.emplace_back();
+    zoneIndexById[zoneId] = z;
+    // Zones that listed this one before it existed
+    auto pending = pendingAdjacency.equal_range(zoneId);
+    for (auto it = pending.first; it != pending.second; ++it) zoneReverseAdjacency[z].push_back(it->second);
+    pendingAdjacency.erase(pending.first, pending.second);
+    topologyEpoch.value++;
+    return z;
+}
+
+int CityLayout::addArea(int zoneIndex, int areaId) {
+    if (zoneIds.empty() || zoneIndex != (int)zoneIds.size() - 1) return -1;
+    int a = (int)areaIds.size();
+    areaIds.push_back(areaId);
+    areaZone.push_back(zoneIndex);
+    areaSlotBegin.push_back((int)slotIds.size()); // New area starts empty
+    areaOccupied.push_back(0);
+    zoneAreaBegin.back()++;
+    return a;
+}
+
+int CityLayout::addSlot(int areaIndex, int slotId) {
+    if (areaIds.empty() || areaIndex != (int)areaIds.size() - 1) return -1;
+    if (slotIndexById.count(slotId)) return -1;
+
+    int s = (int)slotIds.size();
+    slotIds.push_back(slotId);
+    slotArea.push_back(areaIndex);
+    if (occupancyBits.size() * 64 < slotIds.size()) {
+        occupancyBits.push_back(0);
+    }
+
+    // New slot is free: push it onto the area's stack (the area is last, so its stack can grow in place)
+    int freePos = areaSlotBegin[areaIndex] + getAreaCapacity(areaIndex) - areaOccupied[areaIndex];
+    freeStack.push_back(0);
+    freeStack[freePos] = s;
+    freeListPos.push_back(freePos);
+
+    areaSlotBegin.back()++;
+    slotIndexById[slotId] = s;
+    topologyEpoch.value++; // The zone may have just gained its first free slot
+    return s;
+}
+
+void CityLayout::addAdjacency(int zoneIndex, int neighborId) {
+    if (zoneIndex < 0 || zoneIndex >= (int)zoneIds.size()) return;
+    // Avoid duplicates if necessary, but for now simple push
+    zoneAdjacency[zoneIndex].push_back(neighborId);
+    int n = findZoneIndex(neighborId);
+    if (n != -1) zoneReverseAdjacency[n].push_back(zoneIndex);
+    else pendingAdjacency.emplace(neighborId, zoneIndex);
+    topologyEpoch.value++;
+}
+
+namespace {
+
+bool isOffsetColumn(const int* begin, int count, int total) {
+    if (begin[0] != 0 || begin[count] != total) return false;
+    for (int i = 0; i < count; ++i) {
+        if (begin[i] > begin[i + 1]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool CityLayout::loadColumns(const CityColumns& c) {
+    if (!zoneIds.empty() || c.zoneCount < 0 || c.areaCount < 0 || c.slotCount < 0) return false;
+    if (!isOffsetColumn(c.zoneAreaBegin, c.zoneCount, c.areaCount) || !isOffsetColumn(c.areaSlotBegin, c.areaCount, c.slotCount) ||
+        !isOffsetColumn(c.adjacencyBegin, c.zoneCount, c.adjacencyBegin[c.zoneCount])) {
+        return false;
+    }
+    int words = (c.slotCount + 63) / 64;
+    if (c.slotCount % 64 != 0 && (c.occupancy[words - 1] >> (c.slotCount % 64)) != 0) return false; // Bits past the last slot
+
+    zoneIds.assign(c.zoneIds, c.zoneIds + c.zoneCount);
+    zoneAreaBegin.assign(c.zoneAreaBegin, c.zoneAreaBegin + c.zoneCount + 1);
+    zoneShards.resize(c.zoneCount);
+    zoneAdjacency.resize(c.zoneCount);
+    for (int z = 0; z < c.zoneCount; ++z) {
+        zoneAdjacency[z].assign(c.adjacency + c.adjacencyBegin[z], c.adjacency + c.adjacencyBegin[z + 1]);
+    }
+
+    areaIds.assign(c.areaIds, c.areaIds + c.areaCount);
+    areaSlotBegin.assign(c.areaSlotBegin, c.areaSlotBegin + c.areaCount + 1);
+    areaZone.resize(c.areaCount);
+    for (int z = 0; z < c.zoneCount; ++z) {
+        for (int a = zoneAreaBegin[z]; a < zoneAreaBegin[z + 1]; ++a) areaZone[a] = z;
+    }
+
+    slotIds.assign(c.slotIds, c.slotIds + c.slotCount);
+    occupancyBits.assign(c.occupancy, c.occupancy + words);
+    slotArea.resize(c.slotCount);
+    areaOccupied.assign(c.areaCount, 0);
+    for (int a = 0; a < c.areaCount; ++a) {
+        for (int s = areaSlotBegin[a]; s < areaSlotBegin[a + 1]; ++s) {
+            slotArea[s] = a;
+            areaOccupied[a] += (occupancyBits[s / 64] >> (s % 64)) & 1;
+        }
+        zoneShards[areaZone[a]].occupied.value += areaOccupied[a];
+    }
+    freeStack.assign(c.slotCount, 0);
+    freeListPos.assign(c.slotCount, -1);
+    rebuildFreeLists();
+
+    zoneIndexById.reserve(c.zoneCount);
+    slotIndexById.reserve(c.slotCount);
+    bool unique = true;
+    for (int z = 0; z < c.zoneCount && unique; ++z) unique = zoneIndexById.emplace(zoneIds[z], z).second;
+    for (int s = 0; s < c.slotCount && unique; ++s) unique = slotIndexById.emplace(slotIds[s], s).second;
+    if (!unique) {
+        *this = CityLayout();
+        return false;
+    }
+    zoneReverseAdjacency.assign(c.zoneCount, std::vector<int>());
+    for (int z = 0; z < c.zoneCount; ++z) {
+        for (int neighborId : zoneAdjacency[z]) {
+            int n = findZoneIndex(neighborId);
+            if (n != -1) zoneReverseAdjacency[n].push_back(z);
+            else pendingAdjacency.emplace(neighborId, z);
+        }
+    }
+    topologyEpoch.value++;
+    return true;
+}
+
+CityColumns CityLayout::getColumns(std::vector<int>& adjacencyBegin, std::vector<int>& adjacency) const {
+    adjacencyBegin.assign(1, 0);
+    adjacency.clear();
+    for (const auto& neighbors : zoneAdjacency) {
+        adjacency.insert(adjacency.end(), neighbors.begin(), neighbors.end());
+        adjacencyBegin.push_back((int)adjacency.size());
+    }
+    CityColumns c;
+    c.zoneCount = getZoneCount();
+    c.areaCount = getAreaCount();
+    c.slotCount = getSlotCount();
+    c.zoneIds = zoneIds.data();
+    c.zoneAreaBegin = zoneAreaBegin.data();
+    c.adjacencyBegin = adjacencyBegin.data();
+    c.adjacency = adjacency.data();
+    c.areaIds = areaIds.data();
+    c.areaSlotBegin = areaSlotBegin.data();
+    c.slotIds = slotIds.data();
+    c.occupancy = occupancyBits.data();
+    return c;
+}
+
+int CityLayout::getZoneCount() const { return (int)zoneIds.size(); }
+int CityLayout::getAreaCount() const { return (int)areaIds.size(); }
+int CityLayout::getSlotCount() const { return (int)slotIds.size(); }
+
+int CityLayout::findZoneIndex(int zoneId) const {
+    auto it = zoneIndexById.find(zoneId);
+    return it == zoneIndexById.end() ? -1 : it->second;
+}
+
+int CityLayout::findSlotIndex(int slotId) const {
+    auto it = slotIndexById.find(slotId);
+    return it == slotIndexById.end() ? -1 : it->second;
+}
+
+int CityLayout::getZoneId(int z) const { return zoneIds[z]; }
+int CityLayout::getZoneAreaBegin(int z) const { return zoneAreaBegin[z]; }
+int CityLayout::getZoneAreaEnd(int z) const { return zoneAreaBegin[z + 1]; }
+int CityLayout::getZoneOccupied(int z) const { return zoneShards[z].occupied.value.load(std::memory_order_relaxed); }
+const std::vector<int>& CityLayout::getAdjacentZones(int z) const { return zoneAdjacency[z]; }
+
+int CityLayout::getZoneCapacity(int z) const {
+    // Areas of a zone are contiguous, and so are their slots
+    return areaSlotBegin[zoneAreaBegin[z + 1]] - areaSlotBegin[zoneAreaBegin[z]];
+}
+
+int CityLayout::getAreaId(int a) const { return areaIds[a]; }
+int CityLayout::getAreaZone(int a) const { return areaZone[a]; }
+int CityLayout::getAreaSlotBegin(int a) const { return areaSlotBegin[a]; }
+int CityLayout::getAreaSlotEnd(int a) const { return areaSlotBegin[a + 1]; }
+int CityLayout::getAreaCapacity(int a) const { return areaSlotBegin[a + 1] - areaSlotBegin[a]; }
+int CityLayout::getAreaOccupied(int a) const { return __atomic_load_n(&areaOccupied[a], __ATOMIC_RELAXED); }
+
+int CityLayout::getSlotId(int s) const { return slotIds[s]; }
+int CityLayout::getSlotArea(int s) const { return slotArea[s]; }
+int CityLayout::getSlotZone(int s) const { return areaZone[slotArea[s]]; }
+
+bool CityLayout::isOccupied(int s) const {
+    return (__atomic_load_n(&occupancyBits[s / 64], __ATOMIC_RELAXED) >> (s % 64)) & 1;
+}
+
+void CityLayout::countOccupied(int a) {
+    __atomic_fetch_add(&areaOccupied[a], 1, __ATOMIC_RELAXED);
+    int z = areaZone[a];
+    if (zoneShards[z].occupied.value.fetch_add(1) + 1 == getZoneCapacity(z)) zoneCapacityChanged(z); // Zone just became full
+}
+
+void CityLayout::countReleased(int a) {
+    __atomic_fetch_sub(&areaOccupied[a], 1, __ATOMIC_RELAXED);
+    int z = areaZone[a];
+    if (zoneShards[z].occupied.value.fetch_sub(1) == getZoneCapacity(z)) zoneCapacityChanged(z); // Zone just got its first free slot
+}
+
+void CityLayout::zoneCapacityChanged(int z) {
+    // Reverse BFS: zones within the search radius of z are the only ones whose answer can depend on it.
+    // Rare (only on crossings), and the scratch buffers are reused per thread.
+    thread_local std::vector<int> depth;
+    thread_local std::vector<int> visited;
+    int radius = nearestFreeRadius.value.load();
+    if (depth.size() < zoneIds.size()) depth.resize(zoneIds.size(), -1);
+    visited.assign(1, z);
+    depth[z] = 0;
+    for (size_t i = 0; i < visited.size(); ++i) {
+        int y = visited[i];
+        if (depth[y] > 0) zoneShards[y].nearestFreeEpoch.value++;
+        if (depth[y] == radius) continue;
+        for (int x : zoneReverseAdjacency[y]) {
+            if (depth[x] != -1) continue;
+            depth[x] = depth[y] + 1;
+            visited.push_back(x);
+        }
+    }
+    for (int y : visited) depth[y] = -1;
+}
+
+bool CityLayout::occupySlot(int s) {
+    std::uint64_t bit = std::uint64_t(1) << (s % 64);
+    // Atomic RMW: the other bits of this word may belong to another zone, locked by another thread
+    if (__atomic_fetch_or(&occupancyBits[s / 64], bit, __ATOMIC_ACQ_REL) & bit) return false;
+
+    int a = slotArea[s];
+    if (!lockFreeClaiming) {
+        // Swap-remove from the area's free list (O(1); the allocator always takes the top)
+        int top = areaSlotBegin[a] + getAreaCapacity(a) - areaOccupied[a] - 1;
+        int pos = freeListPos[s];
+        int moved = freeStack[top];
+        freeStack[pos] = moved;
+        freeListPos[moved] = pos;
+        freeListPos[s] = -1;
+    }
+    countOccupied(a);
+    return true;
+}
+
+bool CityLayout::releaseSlot(int s) {
+    std::uint64_t bit = std::uint64_t(1) << (s % 64);
+    if (!(__atomic_fetch_and(&occupancyBits[s / 64], ~bit, __ATOMIC_ACQ_REL) & bit)) return false;
+
+    int a = slotArea[s];
+    if (!lockFreeClaiming) {
+        int pos = areaSlotBegin[a] + getAreaCapacity(a) - areaOccupied[a];
+        freeStack[pos] = s;
+        freeListPos[s] = pos;
+    }
+    countReleased(a);
+    return true;
+}
+
+void CityLayout::copyOccupancy(std::vector<std::uint64_t>& out) const {
+    out.resize(occupancyBits.size());
+    for (size_t w = 0; w < occupancyBits.size(); ++w) out[w] = __atomic_load_n(&occupancyBits[w], __ATOMIC_RELAXED);
+}
+
+int CityLayout::findFreeSlot(int a, int from) const {
+    int begin = areaSlotBegin[a];
+    int end = areaSlotBegin[a + 1];
+    if (getAreaOccupied(a) == end - begin) return -1;
+    if (from > begin) begin = from; // Resume point for batch allocation
+    if (begin >= end) return -1;
+
+    // The area's range need not be word aligned, so mask off neighbours' bits at both ends
+    int firstWord = begin / 64;
+    int lastWord = (end - 1) / 64;
+    std::uint64_t headMask = ~std::uint64_t(0) << (begin % 64);
+    std::uint64_t tailMask = (end % 64 == 0) ? ~std::uint64_t(0) : (std::uint64_t(1) << (end % 64)) - 1;
+    if (firstWord == lastWord) headMask &= tailMask;
+
+    std::uint64_t freeBits = ~__atomic_load_n(&occupancyBits[firstWord], __ATOMIC_RELAXED) & headMask;
+    if (freeBits != 0) return firstWord * 64 + __builtin_ctzll(freeBits);
+    for (int w = firstWord + 1; w < lastWord; ++w) {
+        freeBits = ~__atomic_load_n(&occupancyBits[w], __ATOMIC_RELAXED); // Inner words belong to this area alone
+        if (freeBits != 0) return w * 64 + __builtin_ctzll(freeBits);
+    }
+    if (lastWord != firstWord) {
+        freeBits = ~__atomic_load_n(&occupancyBits[lastWord], __ATOMIC_RELAXED) & tailMask;
+        if (freeBits != 0) return lastWord * 64 + __builtin_ctzll(freeBits);
+    }
+    return -1;
+}
+
+int CityLayout::claimFreeSlot(int a, int from) {
+    int begin = areaSlotBegin[a];
+    int end = areaSlotBegin[a + 1];
+    if (getAreaOccupied(a) == end - begin) return -1;
+    if (from > begin) begin = from;
+    if (begin >= end) return -1;
+
+    int firstWord = begin / 64;
+    int lastWord = (end - 1) / 64;
+    for (int w = firstWord; w <= lastWord; ++w) {
+        std::uint64_t mask = ~std::uint64_t(0);
+        if (w == firstWord) mask &= ~std::uint64_t(0) << (begin % 64);
+        if (w == lastWord && end % 64 != 0) mask &= (std::uint64_t(1) << (end % 64)) - 1;
+
+        std::uint64_t word = __atomic_load_n(&occupancyBits[w], __ATOMIC_RELAXED);
+        std::uint64_t freeBits = ~word & mask;
+        while (freeBits != 0) {
+            std::uint64_t bit = freeBits & (~freeBits + 1); // Lowest zero bit of the word
+            // On failure `word` is reloaded, so retry against whatever other threads left free
+            if (__atomic_compare_exchange_n(&occupancyBits[w], &word, word | bit, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                countOccupied(a);
+                return w * 64 + __builtin_ctzll(bit);
+            }
+            freeBits = ~word & mask;
+        }
+    }
+    return -1;
+}
+
+int CityLayout::peekFreeList(int a) const {
+    if (lockFreeClaiming) return findFreeSlot(a);
+    int freeCount = getAreaCapacity(a) - areaOccupied[a];
+    if (freeCount == 0) return -1;
+    return freeStack[areaSlotBegin[a] + freeCount - 1];
+}
+
+NearestFreeStamp CityLayout::stampNearestFree(int z, int hops) {
+    // Widen the invalidation radius first, so crossings from here on reach this search
+    int radius = nearestFreeRadius.value.load();
+    while (radius < hops && !nearestFreeRadius.value.compare_exchange_weak(radius, hops)) {}
+    return NearestFreeStamp{topologyEpoch.value.load(), zoneShards[z].nearestFreeEpoch.value.load()};
+}
+
+bool CityLayout::getCachedNearestFree(int z, int& target, int& hops) const {
+    const ZoneShard& shard = zoneShards[z];
+    if (shard.nearestFreeStamp.topology != topologyEpoch.value.load() ||
+        shard.nearestFreeStamp.zone != shard.nearestFreeEpoch.value.load()) {
+        return false;
+    }
+    target = shard.nearestFreeZone;
+    hops = shard.nearestFreeHops;
+    return true;
+}
+
+void CityLayout::setCachedNearestFree(int z, int target, int hops, NearestFreeStamp stamp) {
+    ZoneShard& shard = zoneShards[z];
+    shard.nearestFreeZone = target;
+    shard.nearestFreeHops = hops;
+    shard.nearestFreeStamp = stamp;
+}
+
+void CityLayout::setZoneLocking(bool enabled) {
+    zoneLocking = enabled;
+}
+
+bool CityLayout::isZoneLocking() const {
+    return zoneLocking;
+}
+
+void CityLayout::setLockFreeClaiming(bool enabled) {
+    if (lockFreeClaiming && !enabled) rebuildFreeLists();
+    lockFreeClaiming = enabled;
+}
+
+bool CityLayout::isLockFreeClaiming() const {
+    return lockFreeClaiming;
+}
+
+void CityLayout::rebuildFreeLists() {
+    // Refill every area's stack from the bitmap, in slot order
+    for (int a = 0; a < getAreaCount(); ++a) {
+        int pos = areaSlotBegin[a];
+        for (int s = areaSlotBegin[a]; s < areaSlotBegin[a + 1]; ++s) {
+            if (isOccupied(s)) {
+                freeListPos[s] = -1;
+            } else {
+                freeStack[pos] = s;
+                freeListPos[s] = pos++;
+            }
+        }
+    }
+}
+
+std::mutex& CityLayout::getZoneLock(int z) {
+    return zoneShards[z].lock.m;
+}
+
+ZoneGuard::ZoneGuard(CityLayout& c, int zoneIndex, int otherZoneIndex) : city(c), first(-1), second(-1) {
+    if (!city.isZoneLocking()) return;
+    // Ascending order, and never lock the same zone twice; -1 means "no zone"
+    if (zoneIndex == -1) std::swap(zoneIndex, otherZoneIndex);
+    if (zoneIndex == -1) return;
+    first = zoneIndex;
+    if (otherZoneIndex != -1 && otherZoneIndex != zoneIndex) {
+        second = otherZoneIndex;
+        if (second < first) std::swap(first, second);
+    }
+    city.getZoneLock(first).lock();
+    if (second != -1) city.getZoneLock(second).lock();
+}
+
+ZoneGuard::~ZoneGuard() {
+    if (second != -1) city.getZoneLock(second).unlock();
+    if (first != -1) city.getZoneLock(first).unlock();
+}
@@ -0,0 +1,214 @@
+#ifndef CITY_LAYOUT_H
+#define CITY_LAYOUT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "Concurrency.h"
+
+// What a nearest-free cache entry was computed under (see CityLayout::stampNearestFree)
+struct NearestFreeStamp {
+    unsigned long topology; // The city's topology epoch
+    unsigned long zone;     // The zone's own nearestFreeEpoch
+};
+
+// Mutable per-zone state. Padded to its own cache line so zones served by different threads
+// never false-share their lock or counters.
+struct alignas(64) ZoneShard {
+    CopyableMutex lock;
+    CopyableAtomic<int> occupied;
+
+    // Nearest-zone-with-free-capacity cache, valid while its stamp matches the city's topology epoch and
+    // nearestFreeEpoch, which is bumped whenever a zone within search reach crosses zero free slots.
+    // The cached fields are only touched with this zone's lock held (when locking is enabled).
+    int nearestFreeZone;  // Zone index, -1 if none within nearestFreeHops
+    int nearestFreeHops;  // Hops to nearestFreeZone, or depth searched when none was found
+    NearestFreeStamp nearestFreeStamp;
+    CopyableAtomic<unsigned long> nearestFreeEpoch;
+
+    ZoneShard() : occupied(0), nearestFreeZone(-1), nearestFreeHops(0), nearestFreeStamp{0, 0}, nearestFreeEpoch(1) {}
+};
+
+// Read-only view of a city's columns, used to write and restore checkpoint images
+// (see ParkingSystem::writeCheckpoint). Adjacency is flattened CSR-style: zone z's neighbor IDs are
+// adjacency[adjacencyBegin[z], adjacencyBegin[z+1]).
+struct CityColumns {
+    int zoneCount;
+    int areaCount;
+    int slotCount;
+    const int* zoneIds;
+    const int* zoneAreaBegin;  // zoneCount+1
+    const int* adjacencyBegin; // zoneCount+1
+    const int* adjacency;
+    const int* areaIds;
+    const int* areaSlotBegin;  // areaCount+1
+    const int* slotIds;
+    const std::uint64_t* occupancy; // (slotCount+63)/64 words
+};
+
+// Flattened (struct-of-arrays) storage for the whole city.
+// Slots live in contiguous columns indexed by a global slot index. Areas and zones are
+// CSR-style offset ranges over those columns: area a owns slots [areaSlotBegin[a], areaSlotBegin[a+1])
+// and zone z owns areas [zoneAreaBegin[z], zoneAreaBegin[z+1]).
+// Construction is append-only: areas go to the last zone, slots to the last area.
+class CityLayout {
+private:
+    // Zone columns
+    std::vector<int> zoneIds;
+    std::vector<int> zoneAreaBegin; // size zones+1
+    std::vector<ZoneShard> zoneShards;
+    std::vector<std::vector<int>> zoneAdjacency; // Neighbor zone IDs (added in any order, so not CSR)
+    std::vector<std::vector<int>> zoneReverseAdjacency; // Indices of the zones listing this one as a neighbor
+    std::unordered_multimap<int, int> pendingAdjacency; // Neighbor ID not added yet -> zone index listing it
+    CopyableAtomic<unsigned long> topologyEpoch; // Bumped whenever zones, slots or adjacency change
+    CopyableAtomic<int> nearestFreeRadius;       // Deepest search any nearest-free cache entry covers
+    bool zoneLocking; // Take ZoneShard::lock around zone mutations (see ZoneGuard)
+    bool lockFreeClaiming; // Bitmap is the only occupancy structure; free lists are not maintained
+
+    // Area columns
+    std::vector<int> areaIds;
+    std::vector<int> areaZone;      // Owning zone index
+    std::vector<int> areaSlotBegin; // size areas+1
+    std::vector<int> areaOccupied;
+
+    // Slot columns
+    std::vector<int> slotIds;
+    std::vector<int> slotArea;                 // Owning area index (zone is one hop away via areaZone)
+    std::vector<std::uint64_t> occupancyBits;  // One bit per slot (1 = occupied), 64 slots per word
+    std::vector<int> freeStack;   // Per-area LIFO free lists; area a's stack starts at areaSlotBegin[a]
+    std::vector<int> freeListPos; // Slot -> position in freeStack, -1 while occupied
+
+    std::unordered_map<int, int> zoneIndexById; // Zone ID -> zone index
+    std::unordered_map<int, int> slotIndexById; // Slot ID -> slot index
+
+    // Counter side of an occupancy change (area, zone, nearest-free caches)
+    void countOccupied(int a);
+    void countReleased(int a);
+    // Zone z just became full or got its first free slot: invalidates the caches of zones that can reach it
+    void zoneCapacityChanged(int z);
+    void rebuildFreeLists();
+
+public:
+    CityLayout();
+
+    // Construction. Each returns the new index, or -1 if rejected.
+    int addZone(int zoneId);                 // Rejects duplicate IDs
+    int addArea(int zoneIndex, int areaId);  // Only into the last zone
+    int addSlot(int areaIndex, int slotId);  // Only into the last area; rejects duplicate slot IDs
+    void addAdjacency(int zoneIndex, int neighborId);
+
+    // Bulk restore into an empty layout: columns are copied in whole and the derived state
+    // (owners, counters, free lists, ID lookups) is rebuilt. False if the columns are inconsistent.
+    bool loadColumns(const CityColumns& columns);
+    // Views of the live columns; adjacency is flattened into the given vectors.
+    // Occupancy is read without atomics, so no mutation may be in flight.
+    CityColumns getColumns(std::vector<int>& adjacencyBegin, std::vector<int>& adjacency) const;
+
+    int getZoneCount() const;
+    int getAreaCount() const;
+    int getSlotCount() const;
+
+    // O(1) lookups by ID, -1 if unknown
+    int findZoneIndex(int zoneId) const;
+    int findSlotIndex(int slotId) const;
+
+    // Zones
+    int getZoneId(int z) const;
+    int getZoneAreaBegin(int z) const;
+    int getZoneAreaEnd(int z) const;
+    int getZoneCapacity(int z) const;
+    int getZoneOccupied(int z) const;
+    const std::vector<int>& getAdjacentZones(int z) const;
+
+    // Areas
+    int getAreaId(int a) const;
+    int getAreaZone(int a) const;
+    int getAreaSlotBegin(int a) const;
+    int getAreaSlotEnd(int a) const;
+    int getAreaCapacity(int a) const;
+    int getAreaOccupied(int a) const;
+
+    // Slots
+    int getSlotId(int s) const;
+    int getSlotArea(int s) const;
+    int getSlotZone(int s) const;
+    bool isOccupied(int s) const;
+
+    // Occupancy. Both return false if the slot was already in the requested state.
+    // Bitmap, free list and area/zone counters are kept in sync here.
+    // With zone locking enabled the caller must hold the slot's zone (ZoneGuard); bitmap words
+    // are updated atomically because neighbouring zones can share a word.
+    // With lock-free claiming both are safe without any lock.
+    bool occupySlot(int s);
+    bool releaseSlot(int s);
+
+    void copyOccupancy(std::vector<std::uint64_t>& out) const; // Bitmap words, read atomically
+    int findFreeSlot(int a, int from = -1) const; // First free slot of the area at or after `from` via find-first-zero, -1 if none
+    int peekFreeList(int a) const;   // Most recently freed slot of the area in O(1), -1 if full
+    int claimFreeSlot(int a, int from = -1); // Find-first-zero plus compare-and-swap on the word; lock-free, -1 if none
+
+    // Lock-free claiming: allocation needs no zone lock, the bitmap alone records occupancy.
+    // Free lists are dropped while it is on (peekFreeList falls back to the bitmap) and rebuilt when it is turned off.
+    void setLockFreeClaiming(bool enabled);
+    bool isLockFreeClaiming() const;
+
+    // Nearest-free-zone cache used by the cross-zone fallback. Caller holds zone z when locking is enabled.
+    // Take the stamp before searching up to `hops` away and store the answer under it, so a zone that
+    // fills or frees during the search leaves the entry stale.
+    NearestFreeStamp stampNearestFree(int z, int hops);
+    bool getCachedNearestFree(int z, int& target, int& hops) const; // False if stale
+    void setCachedNearestFree(int z, int target, int hops, NearestFreeStamp stamp);
+
+    // Per-zone locking for concurrent use. Off by default (single-threaded callers pay nothing).
+    void setZoneLocking(bool enabled);
+    bool isZoneLocking() const;
+    std::mutex& getZoneLock(int z);
+};
+
+// Locks one or two zones for the current scope. Two zones are always taken in ascending
+// zone-index order, so concurrent cross-zone allocations can never deadlock.
+// Does nothing unless zone locking is enabled on the city. A zone index of -1 is ignored.
+class ZoneGuard {
+private:
+    CityLayout& city;
+    int first;
+    int second;
+
+public:
+    ZoneGuard(CityLayout& c, int zoneIndex, int otherZoneIndex = -1);
+    ~ZoneGuard();
+    ZoneGuard(const ZoneGuard&) = delete;
+    ZoneGuard& operator=(const ZoneGuard&) = delete;
+};
+
+// Iterable, indexable range of lightweight views (Zone, ParkingArea, ParkingSlot) over a CityLayout
+template <typename View>
+class ViewRange {
+private:
+    CityLayout* city;
+    int first;
+    int last;
+
+public:
+    class iterator {
+    private:
+        CityLayout* city;
+        int pos;
+    public:
+        iterator(CityLayout* c, int p) : city(c), pos(p) {}
+        View operator*() const { return View(city, pos); }
+        iterator& operator++() { ++pos; return *this; }
+        bool operator!=(const iterator& other) const { return pos != other.pos; }
+    };
+
+    ViewRange(CityLayout* c, int b, int e) : city(c), first(b), last(e) {}
+
+    iterator begin() const { return iterator(city, first); }
+    iterator end() const { return iterator(city, last); }
+    size_t size() const { return (size_t)(last - first); }
+    bool empty() const { return first == last; }
+    View operator[](size_t i) const { return View(city, first + (int)i); }
+};
+
+#endif // CITY_LAYOUT_H
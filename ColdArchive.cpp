@@ -0,0 +1,186 @@
+#include "ColdArchive.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+void putVarint(std::vector<char>& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+std::uint64_t zigzag(std::int64_t v) {
+    return ((std::uint64_t)v << 1) ^ (std::uint64_t)(v >> 63); // Small magnitudes of either sign stay short
+}
+
+std::int64_t unzigzag(std::uint64_t u) {
+    return (std::int64_t)(u >> 1) ^ -(std::int64_t)(u & 1);
+}
+
+void putSigned(std::vector<char>& out, std::int64_t v) {
+    putVarint(out, zigzag(v));
+}
+
+bool getVarint(const char* data, size_t length, size_t& pos, std::uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < length; shift += 7) {
+        unsigned char byte = (unsigned char)data[pos++];
+        v |= (std::uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool getSigned(const char* data, size_t length, size_t& pos, std::int64_t& v) {
+    std::uint64_t u;
+    if (!getVarint(data, length, pos, u)) return false;
+    v = unzigzag(u);
+    return true;
+}
+
+// Decodes one block, calling visit per record; false if the bytes do not hold exactly `count` records.
+// reserveIds makes new request IDs continue after the decoded ones (restoring, not scanning).
+template <typename Visit>
+bool decodeBlock(const char* data, size_t length, size_t count, bool reserveIds, Visit visit) {
+    size_t pos = 0;
+    int lastId = 0;
+    time_t lastTime = 0;
+    std::string vehicle;
+    for (size_t i = 0; i < count; ++i) {
+        std::int64_t id, zone, slot, assignedZone, created;
+        std::uint64_t state, ended, shared, suffix;
+        if (!getSigned(data, length, pos, id) || !getSigned(data, length, pos, zone) || !getSigned(data, length, pos, slot) ||
+            !getSigned(data, length, pos, assignedZone) || !getVarint(data, length, pos, state) ||
+            !getSigned(data, length, pos, created) || !getVarint(data, length, pos, ended) ||
+            !getVarint(data, length, pos, shared) || !getVarint(data, length, pos, suffix) ||
+            shared > vehicle.size() || suffix > length - pos || state > (std::uint64_t)RequestState::CANCELLED) {
+            return false;
+        }
+        vehicle.resize(shared);
+        vehicle.append(data + pos, suffix);
+        pos += suffix;
+        lastId += (int)id;
+        lastTime += (time_t)created;
+        ParkingRequest req(lastId, vehicle, (int)zone, lastTime, reserveIds);
+        req.forceState((RequestState)state);
+        req.assignSlot((int)slot, (int)assignedZone);
+        req.setEndTime(ended == 0 ? 0 : lastTime + (time_t)unzigzag(ended - 1));
+        visit(req);
+    }
+    return pos == length;
+}
+
+} // namespace
+
+ColdArchive::ColdArchive() : recordCount(0), byteCount(0), droppedCount(0) {}
+
+void ColdArchive::append(const ParkingRequest& req, time_t finished) {
+    if (blocks.empty() || blocks.back().count == BLOCK_RECORDS) blocks.emplace_back();
+    Block& b = blocks.back();
+    size_t before = b.bytes.size();
+
+    const std::string vehicle = req.getVehicleId();
+    size_t shared = 0;
+    while (shared < vehicle.size() && shared < b.lastVehicle.size() && vehicle[shared] == b.lastVehicle[shared]) shared++;
+    putSigned(b.bytes, (std::int64_t)req.getRequestId() - b.lastId);
+    putSigned(b.bytes, req.getRequestedZoneId());
+    putSigned(b.bytes, req.getAssignedSlotId());
+    putSigned(b.bytes, req.getAssignedZoneId());
+    putVarint(b.bytes, (std::uint64_t)req.getState());
+    putSigned(b.bytes, (std::int64_t)(req.getRequestTime() - b.lastTime));
+    // 0 for no end time, else 1 + the duration
+    putVarint(b.bytes, req.getEndTime() == 0 ? 0 : zigzag((std::int64_t)(req.getEndTime() - req.getRequestTime())) + 1);
+    putVarint(b.bytes, shared);
+    putVarint(b.bytes, vehicle.size() - shared);
+    b.bytes.insert(b.bytes.end(), vehicle.begin() + shared, vehicle.end());
+
+    b.lastId = req.getRequestId();
+    b.lastTime = req.getRequestTime();
+    b.lastVehicle = vehicle;
+    if (b.count == 0 || finished > b.newestEnd) b.newestEnd = finished;
+    b.count++;
+    if (b.count == BLOCK_RECORDS) {
+        b.bytes.shrink_to_fit(); // Sealed: give back the growth slack
+        b.lastVehicle.clear();
+        b.lastVehicle.shrink_to_fit();
+    }
+    recordCount++;
+    byteCount += b.bytes.size() - before;
+}
+
+size_t ColdArchive::dropFinishedBefore(time_t cutoff) {
+    size_t dropped = 0;
+    // The block being filled stays even if it qualifies, so appends keep their encoder state
+    while (blocks.size() > 1 && blocks.front().newestEnd < cutoff) {
+        dropped += blocks.front().count;
+        recordCount -= blocks.front().count;
+        byteCount -= blocks.front().bytes.size();
+        blocks.pop_front();
+    }
+    droppedCount += dropped;
+    return dropped;
+}
+
+void ColdArchive::scan(const std::function<void(const ParkingRequest&)>& visit) const {
+    for (const Block& b : blocks) decodeBlock(b.bytes.data(), b.bytes.size(), b.count, false, visit);
+}
+
+size_t ColdArchive::getRecordCount() const {
+    return recordCount;
+}
+
+size_t ColdArchive::getByteCount() const {
+    return byteCount;
+}
+
+unsigned long ColdArchive::getDroppedCount() const {
+    return droppedCount;
+}
+
+void ColdArchive::encode(std::vector<char>& out) const {
+    for (const Block& b : blocks) {
+        std::uint64_t header[3] = {(std::uint64_t)b.count, (std::uint64_t)(std::int64_t)b.newestEnd, (std::uint64_t)b.bytes.size()};
+        out.insert(out.end(), (const char*)header, (const char*)header + sizeof(header));
+        out.insert(out.end(), b.bytes.begin(), b.bytes.end());
+        out.resize((out.size() + 7) & ~size_t(7), 0);
+    }
+}
+
+bool ColdArchive::decode(const char* data, size_t length, unsigned long dropped) {
+    std::deque<Block> decoded;
+    size_t records = 0;
+    size_t bytes = 0;
+    size_t pos = 0;
+    while (pos < length) {
+        std::uint64_t header[3];
+        if (length - pos < sizeof(header)) return false;
+        std::memcpy(header, data + pos, sizeof(header));
+        pos += sizeof(header);
+        if (header[0] == 0 || header[0] > BLOCK_RECORDS || header[2] > length - pos) return false;
+
+        Block b;
+        b.count = (size_t)header[0];
+        b.newestEnd = (time_t)(std::int64_t)header[1];
+        b.bytes.assign(data + pos, data + pos + header[2]);
+        // Validates the block and leaves the encoder state of the last one ready for appends
+        bool ok = decodeBlock(b.bytes.data(), b.bytes.size(), b.count, true, [&](const ParkingRequest& req) {
+            b.lastId = req.getRequestId();
+            b.lastTime = req.getRequestTime();
+            b.lastVehicle = req.getVehicleId();
+        });
+        if (!ok) return false;
+        if (b.count == BLOCK_RECORDS) b.lastVehicle.clear();
+        pos = (pos + (size_t)header[2] + 7) & ~size_t(7);
+        records += b.count;
+        bytes += b.bytes.size();
+        decoded.push_back(std::move(b));
+    }
+    blocks.swap(decoded);
+    recordCount = records;
+    byteCount = bytes;
+    droppedCount = dropped;
+    return true;
+}
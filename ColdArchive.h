@@ -0,0 +1,52 @@
+#ifndef COLD_ARCHIVE_H
+#define COLD_ARCHIVE_H
+
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "ParkingRequest.h"
+
+// Append-only store of finished (RELEASED/CANCELLED) requests moved out of ParkingSystem's request table
+// (see ParkingSystem::archiveRequests). Records are packed into blocks of up to BLOCK_RECORDS, each encoded
+// on its own: varints, IDs and times as deltas from the previous record, vehicle IDs front-coded against
+// the previous one. Blocks are only ever appended, scanned in order, or dropped whole from the front.
+class ColdArchive {
+private:
+    struct Block {
+        std::vector<char> bytes;
+        size_t count = 0;
+        time_t newestEnd = 0; // Latest finish time in the block, for retention
+        // Encoder state carried between records of the block being filled
+        int lastId = 0;
+        time_t lastTime = 0;
+        std::string lastVehicle;
+    };
+
+    std::deque<Block> blocks; // Oldest first; only the last one is still being filled
+    size_t recordCount;
+    size_t byteCount;
+    unsigned long droppedCount;
+
+public:
+    static const size_t BLOCK_RECORDS = 4096;
+
+    ColdArchive();
+
+    void append(const ParkingRequest& req, time_t finished);
+    // Drops whole blocks, oldest first, whose requests all finished before `cutoff`; returns the records dropped
+    size_t dropFinishedBefore(time_t cutoff);
+    // Decodes every record, oldest first
+    void scan(const std::function<void(const ParkingRequest&)>& visit) const;
+
+    size_t getRecordCount() const;
+    size_t getByteCount() const; // Encoded size
+    unsigned long getDroppedCount() const;
+
+    // Checkpoint images: [u64 count][i64 newestEnd][u64 length][bytes, padded to 8] per block
+    void encode(std::vector<char>& out) const;
+    bool decode(const char* data, size_t length, unsigned long dropped);
+};
+
+#endif // COLD_ARCHIVE_H
@@ -0,0 +1,171 @@
+#include "CommandPipeline.h"
+#include <chrono>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+CommandPipeline::CommandPipeline(ParkingSystem& ps, size_t capacity, int cpu)
+    : system(ps), tail(0), head(0), writerSleeping(false), commandsExecuted(0), batchesDrained(0) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    ring.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; ++i) ring[i].seq.store(i, std::memory_order_relaxed);
+
+    writer = std::thread(&CommandPipeline::run, this);
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(writer.native_handle(), sizeof(set), &set); // Best effort
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+CommandPipeline::~CommandPipeline() {
+    submit(STOP, "", 0).wait(); // Everything queued before STOP runs first
+    writer.join();
+}
+
+CommandPipeline::Cell* CommandPipeline::claim(size_t& pos) {
+    pos = tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &ring[pos & mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (seq < pos) {
+            std::this_thread::yield(); // Ring full: wait for the writer to free this cell
+            pos = tail.load(std::memory_order_relaxed);
+        } else {
+            pos = tail.load(std::memory_order_relaxed); // Another producer took it
+        }
+    }
+    return cell;
+}
+
+void CommandPipeline::publish(Cell* cell, size_t pos) {
+    cell->seq.store(pos + 1, std::memory_order_release);
+
+    if (writerSleeping.load()) {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        wakeUp.notify_one();
+    }
+}
+
+std::future<int> CommandPipeline::submit(CommandType type, const std::string& vehicleId, int arg) {
+    size_t pos;
+    Cell* cell = claim(pos);
+    cell->cmd.type = type;
+    cell->cmd.vehicleId = vehicleId;
+    cell->cmd.arg = arg;
+    cell->cmd.result = std::promise<int>();
+    std::future<int> future = cell->cmd.result.get_future();
+    publish(cell, pos);
+    return future;
+}
+
+void CommandPipeline::run() {
+    int idlePolls = 0;
+    while (true) {
+        // Drain up to MAX_BATCH filled cells in ring order
+        size_t drained = 0;
+        bool stop = false;
+        while (drained < MAX_BATCH) {
+            Cell& cell = ring[head & mask];
+            if (cell.seq.load(std::memory_order_acquire) != head + 1) break;
+            if (cell.cmd.type == STOP) {
+                stop = true;
+                cell.cmd.result.set_value(0);
+            } else {
+                commandsExecuted++; // Counted before the caller's future completes
+                execute(cell.cmd);
+            }
+            cell.seq.store(head + mask + 1, std::memory_order_release); // Free for the producer one lap later
+            head++;
+            drained++;
+        }
+        if (drained > 0) {
+            batchesDrained++;
+            idlePolls = 0;
+        }
+        if (stop) return;
+        if (drained > 0) continue;
+
+        if (++idlePolls < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        // Park until a producer notices writerSleeping; the timeout covers a notify that raced the flag
+        std::unique_lock<std::mutex> lock(sleepLock);
+        writerSleeping.store(true);
+        if (ring[head & mask].seq.load(std::memory_order_acquire) != head + 1) {
+            wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        writerSleeping.store(false);
+    }
+}
+
+void CommandPipeline::execute(Command& cmd) {
+    switch (cmd.type) {
+        case REQUEST:
+            cmd.result.set_value(system.requestParking(cmd.vehicleId, cmd.arg));
+            break;
+        case REQUEST_BATCH:
+            cmd.batchResult.set_value(system.requestParkingBatch(cmd.batch));
+            cmd.batch.clear();
+            break;
+        case CANCEL:
+            cmd.result.set_value(system.cancelRequest(cmd.arg) ? 1 : 0);
+            break;
+        case LEAVE:
+            cmd.result.set_value(system.leaveParking(cmd.arg) ? 1 : 0);
+            break;
+        case ROLLBACK:
+            system.rollbackOperations(cmd.arg);
+            cmd.result.set_value(0);
+            break;
+        case STOP:
+            break;
+    }
+}
+
+std::future<int> CommandPipeline::requestParking(const std::string& vehicleId, int preferredZoneId) {
+    return submit(REQUEST, vehicleId, preferredZoneId);
+}
+
+std::future<std::vector<int>> CommandPipeline::requestParkingBatch(std::vector<ParkingRequestSpec> batch) {
+    size_t pos;
+    Cell* cell = claim(pos);
+    cell->cmd.type = REQUEST_BATCH;
+    cell->cmd.batch = std::move(batch);
+    cell->cmd.batchResult = std::promise<std::vector<int>>();
+    std::future<std::vector<int>> future = cell->cmd.batchResult.get_future();
+    publish(cell, pos);
+    return future;
+}
+
+std::future<int> CommandPipeline::cancelRequest(int requestId) {
+    return submit(CANCEL, "", requestId);
+}
+
+std::future<int> CommandPipeline::leaveParking(int requestId) {
+    return submit(LEAVE, "", requestId);
+}
+
+std::future<int> CommandPipeline::rollbackOperations(int k) {
+    return submit(ROLLBACK, "", k);
+}
+
+long CommandPipeline::getCommandsExecuted() const {
+    return commandsExecuted.load();
+}
+
+long CommandPipeline::getBatchesDrained() const {
+    return batchesDrained.load();
+}
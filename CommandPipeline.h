@@ -0,0 +1,83 @@
+#ifndef COMMAND_PIPELINE_H
+#define COMMAND_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ParkingSystem.h"
+
+// Single-writer front end for a ParkingSystem.
+// Any number of threads submit mutating calls into a bounded MPSC ring; one writer thread
+// (optionally pinned to a CPU) owns the system, drains commands in batches and completes
+// each caller's future. Operations reach the RollbackManager in exactly the ring's order.
+class CommandPipeline {
+public:
+    enum CommandType { REQUEST, REQUEST_BATCH, CANCEL, LEAVE, ROLLBACK, STOP };
+
+private:
+    struct Command {
+        CommandType type;
+        std::string vehicleId;
+        int arg; // Zone ID, request ID or k
+        std::promise<int> result;
+        std::vector<ParkingRequestSpec> batch;         // REQUEST_BATCH only
+        std::promise<std::vector<int>> batchResult; // REQUEST_BATCH only
+    };
+
+    // Ring cell: seq == position means free for that producer, position + 1 means filled
+    struct Cell {
+        std::atomic<size_t> seq;
+        Command cmd;
+    };
+
+    ParkingSystem& system;
+    std::unique_ptr<Cell[]> ring;
+    size_t mask; // Capacity - 1 (capacity is a power of two)
+    alignas(64) std::atomic<size_t> tail; // Next position producers claim
+    alignas(64) size_t head;              // Next position the writer drains (writer only)
+
+    // Idle writer parks here instead of spinning
+    std::atomic<bool> writerSleeping;
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+
+    std::atomic<long> commandsExecuted;
+    std::atomic<long> batchesDrained;
+    std::thread writer;
+
+    Cell* claim(size_t& pos); // Blocks (yielding) while the ring is full
+    void publish(Cell* cell, size_t pos);
+    std::future<int> submit(CommandType type, const std::string& vehicleId, int arg);
+    void run();
+    void execute(Command& cmd);
+
+public:
+    static const size_t MAX_BATCH = 64;
+
+    // capacity is rounded up to a power of two; cpu >= 0 pins the writer thread (Linux only)
+    CommandPipeline(ParkingSystem& ps, size_t capacity = 1024, int cpu = -1);
+    ~CommandPipeline(); // Executes everything already submitted, then joins the writer
+
+    CommandPipeline(const CommandPipeline&) = delete;
+    CommandPipeline& operator=(const CommandPipeline&) = delete;
+
+    // Same calls as ParkingSystem. Futures yield the request ID, 1/0 for cancel/leave, 0 for rollback.
+    // Blocks (yielding) while the ring is full.
+    std::future<int> requestParking(const std::string& vehicleId, int preferredZoneId);
+    // One command for the whole batch, so it keeps requestParkingBatch's single commit
+    std::future<std::vector<int>> requestParkingBatch(std::vector<ParkingRequestSpec> batch);
+    std::future<int> cancelRequest(int requestId);
+    std::future<int> leaveParking(int requestId);
+    std::future<int> rollbackOperations(int k);
+
+    long getCommandsExecuted() const;
+    long getBatchesDrained() const;
+};
+
+#endif // COMMAND_PIPELINE_H
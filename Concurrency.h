@@ -0,0 +1,40 @@
+#ifndef CONCURRENCY_H
+#define CONCURRENCY_H
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+// Small wrappers that let containers of per-zone state stay copyable.
+// Copies are only made while the city is being assembled (single-threaded),
+// so a copy simply takes the current value and gets a fresh, unlocked mutex.
+
+template <typename T>
+struct CopyableAtomic {
+    std::atomic<T> value;
+
+    CopyableAtomic(T v = T()) : value(v) {}
+    CopyableAtomic(const CopyableAtomic& other) : value(other.value.load()) {}
+    CopyableAtomic& operator=(const CopyableAtomic& other) {
+        value.store(other.value.load());
+        return *this;
+    }
+};
+
+struct CopyableMutex {
+    std::mutex m;
+
+    CopyableMutex() {}
+    CopyableMutex(const CopyableMutex&) {}
+    CopyableMutex& operator=(const CopyableMutex&) { return *this; }
+};
+
+struct CopyableSharedMutex {
+    std::shared_mutex m;
+
+    CopyableSharedMutex() {}
+    CopyableSharedMutex(const CopyableSharedMutex&) {}
+    CopyableSharedMutex& operator=(const CopyableSharedMutex&) { return *this; }
+};
+
+#endif // CONCURRENCY_H
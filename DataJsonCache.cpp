@@ -0,0 +1,181 @@
+#include "DataJsonCache.h"
+
+void writeSlotJson(JsonWriter& json, const StateSnapshot& snap, int s) {
+    json.raw("{ ").key("id").number(snap.getSlotId(s)).raw(", ").key("occupied").boolean(snap.isOccupied(s)).raw(" }");
+}
+
+void writeRequestJson(JsonWriter& json, const ParkingRequest& r) {
+    json.raw("{ ").key("id").number(r.getRequestId())
+        .raw(", ").key("vehicleId").string(r.getVehicleId())
+        .raw(", ").key("zoneId").number(r.getRequestedZoneId())
+        .raw(", ").key("slotId").number(r.getAssignedSlotId())
+        .raw(", ").key("state").string(r.getStateString())
+        .raw(", ").key("duration").number(r.getDuration()).raw(" }");
+}
+
+std::string dataJsonEtag(long epoch, unsigned long version) {
+    JsonWriter json;
+    json.raw("\"").number(epoch).raw("-").number(version).raw("\"");
+    return json.str();
+}
+
+DataJsonCache::DataJsonCache(long e)
+    : epoch(e), version(0), slotCount(0), zoneRenders(0), requestRenders(0) {}
+
+void DataJsonCache::renderZone(const StateSnapshot& snap, int z, std::string& fragment) {
+    zoneRenders++;
+    writer.clear();
+    writer.raw("{ ").key("id").number(snap.getZoneId(z)).raw(", ").key("areas").raw("[");
+    for (int a = snap.getZoneAreaBegin(z); a < snap.getZoneAreaEnd(z); ++a) {
+        writer.raw("{ ").key("id").number(snap.getAreaId(a)).raw(", ").key("slots").raw("[");
+        for (int s = snap.getAreaSlotBegin(a); s < snap.getAreaSlotEnd(a); ++s) {
+            writeSlotJson(writer, snap, s);
+            if (s < snap.getAreaSlotEnd(a) - 1) writer.raw(",");
+        }
+        writer.raw("] }");
+        if (a < snap.getZoneAreaEnd(z) - 1) writer.raw(",");
+    }
+    writer.raw("] }");
+    fragment.assign(writer.data(), writer.size()); // Reuses the fragment's buffer when it is big enough
+}
+
+void DataJsonCache::renderRequest(const ParkingRequest& r, std::string& fragment) {
+    requestRenders++;
+    writer.clear();
+    writeRequestJson(writer, r);
+    fragment.assign(writer.data(), writer.size());
+}
+
+std::shared_ptr<const std::string> DataJsonCache::get(ParkingSystem& ps, const StateSnapshot& snap, std::string& tag) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (document && snap.getVersion() <= version) {
+        tag = etag;
+        return document; // Quiet city, or a caller holding an older snapshot: serve what is cached
+    }
+
+    const std::vector<ParkingRequest>& reqs = snap.getRequests();
+    std::vector<int> slots;
+    std::vector<int> changed;
+    // The city only grows, so an unchanged slot count means the same zones, areas and slots
+    bool incremental = document && slotCount == snap.getSlotCount() && (int)zoneFragments.size() == snap.getZoneCount() &&
+                       ps.getChangesSince(version, snap, slots, changed);
+    if (!incremental) {
+        zoneFragments.resize(snap.getZoneCount());
+        for (int z = 0; z < snap.getZoneCount(); ++z) renderZone(snap, z, zoneFragments[z]);
+        requestFragments.resize(reqs.size());
+        for (size_t pos = 0; pos < reqs.size(); ++pos) renderRequest(reqs[pos], requestFragments[pos]);
+    } else {
+        // Changed slots are ascending, so their zones come out ascending too
+        int lastZone = -1;
+        for (int s : slots) {
+            int a = 0, hi = snap.getZoneAreaEnd(snap.getZoneCount() - 1) - 1;
+            while (a < hi) { // Last area starting at or before s
+                int mid = (a + hi + 1) / 2;
+                if (snap.getAreaSlotBegin(mid) <= s) a = mid; else hi = mid - 1;
+            }
+            int z = 0;
+            hi = snap.getZoneCount() - 1;
+            while (z < hi) {
+                int mid = (z + hi + 1) / 2;
+                if (snap.getZoneAreaBegin(mid) <= a) z = mid; else hi = mid - 1;
+            }
+            if (z != lastZone) renderZone(snap, z, zoneFragments[z]);
+            lastZone = z;
+        }
+        size_t known = requestFragments.size();
+        for (int pos : changed) {
+            if ((size_t)pos < known) renderRequest(reqs[pos], requestFragments[pos]);
+        }
+        requestFragments.resize(reqs.size());
+        for (size_t pos = known; pos < reqs.size(); ++pos) renderRequest(reqs[pos], requestFragments[pos]);
+    }
+    slotCount = snap.getSlotCount();
+    version = snap.getVersion();
+
+    size_t size = 128;
+    for (const std::string& f : zoneFragments) size += f.size() + 1;
+    for (const std::string& f : requestFragments) size += f.size() + 1;
+    std::shared_ptr<std::string> doc = std::make_shared<std::string>();
+    doc->reserve(size); // The one allocation per new version
+    writer.clear();
+    writer.raw("{ ").key("version").number(version).raw(", ").key("epoch").number(epoch)
+          .raw(", ").key("full").boolean(true).raw(", ").key("zones").raw("[");
+    doc->append(writer.data(), writer.size());
+    for (size_t z = 0; z < zoneFragments.size(); ++z) {
+        if (z > 0) *doc += ',';
+        *doc += zoneFragments[z];
+    }
+    *doc += "], \"requests\": [";
+    for (size_t i = 0; i < requestFragments.size(); ++i) {
+        if (i > 0) *doc += ',';
+        *doc += requestFragments[i];
+    }
+    *doc += "] }";
+    document = doc;
+    etag = dataJsonEtag(epoch, version);
+    tag = etag;
+    return document;
+}
+
+unsigned long DataJsonCache::getZoneRenders() {
+    std::lock_guard<std::mutex> guard(lock);
+    return zoneRenders;
+}
+
+unsigned long DataJsonCache::getRequestRenders() {
+    std::lock_guard<std::mutex> guard(lock);
+    return requestRenders;
+}
+
+DataJsonStream::DataJsonStream(std::shared_ptr<const StateSnapshot> s, long e)
+    : snap(std::move(s)), epoch(e), stage(HEADER), zone(0), area(-1), slot(-1), request(0) {}
+
+bool DataJsonStream::next(size_t chunkBytes) {
+    writer.clear();
+    if (stage == HEADER) {
+        writer.raw("{ ").key("version").number(snap->getVersion()).raw(", ").key("epoch").number(epoch)
+              .raw(", ").key("full").boolean(true).raw(", ").key("zones").raw("[");
+        stage = ZONES;
+    }
+    // Same layout as DataJsonCache's fragments, resumed slot by slot so one huge zone is split across chunks too
+    while (stage == ZONES && writer.size() < chunkBytes) {
+        if (zone == snap->getZoneCount()) {
+            writer.raw("], \"requests\": [");
+            stage = REQUESTS;
+        } else if (area == -1) {
+            if (zone > 0) writer.raw(",");
+            writer.raw("{ ").key("id").number(snap->getZoneId(zone)).raw(", ").key("areas").raw("[");
+            area = snap->getZoneAreaBegin(zone);
+        } else if (area == snap->getZoneAreaEnd(zone)) {
+            writer.raw("] }");
+            zone++;
+            area = -1;
+        } else if (slot == -1) {
+            if (area > snap->getZoneAreaBegin(zone)) writer.raw(",");
+            writer.raw("{ ").key("id").number(snap->getAreaId(area)).raw(", ").key("slots").raw("[");
+            slot = snap->getAreaSlotBegin(area);
+        } else if (slot == snap->getAreaSlotEnd(area)) {
+            writer.raw("] }");
+            area++;
+            slot = -1;
+        } else {
+            if (slot > snap->getAreaSlotBegin(area)) writer.raw(",");
+            writeSlotJson(writer, *snap, slot++);
+        }
+    }
+    const std::vector<ParkingRequest>& reqs = snap->getRequests();
+    while (stage == REQUESTS && writer.size() < chunkBytes) {
+        if (request == reqs.size()) {
+            writer.raw("] }");
+            stage = DONE;
+        } else {
+            if (request > 0) writer.raw(",");
+            writeRequestJson(writer, reqs[request++]);
+        }
+    }
+    return writer.size() > 0;
+}
+
+const JsonWriter& DataJsonStream::chunk() const {
+    return writer;
+}
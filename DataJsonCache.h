@@ -0,0 +1,69 @@
+#ifndef DATA_JSON_CACHE_H
+#define DATA_JSON_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ParkingSystem.h"
+#include "JsonWriter.h"
+
+// JSON shapes shared by /api/data and /api/events
+void writeSlotJson(JsonWriter& json, const StateSnapshot& snap, int s);
+void writeRequestJson(JsonWriter& json, const ParkingRequest& r);
+std::string dataJsonEtag(long epoch, unsigned long version); // ETag of the full document of one snapshot version
+
+// Serialized full /api/data document, kept between polls. Each zone and each request is cached as
+// its own fragment; a newer snapshot re-renders only the zones whose slots changed and the requests
+// that changed or were appended (from ParkingSystem::getChangesSince), then re-joins the fragments.
+// Polls that see the same version get the same document, and an ETag for If-None-Match.
+class DataJsonCache {
+private:
+    long epoch; // Server run, part of the document and the ETag
+    std::mutex lock;
+    unsigned long version; // Snapshot version of `document`, 0 before the first render
+    int slotCount;         // Layout the fragments were rendered for
+    std::vector<std::string> zoneFragments;
+    std::vector<std::string> requestFragments;
+    std::shared_ptr<const std::string> document;
+    std::string etag;
+    unsigned long zoneRenders;
+    unsigned long requestRenders;
+    JsonWriter writer; // Scratch for fragments and the joined document
+
+    void renderZone(const StateSnapshot& snap, int z, std::string& fragment);
+    void renderRequest(const ParkingRequest& r, std::string& fragment);
+
+public:
+    explicit DataJsonCache(long epoch);
+
+    // Document for `snap` (or for a newer version already cached), with its ETag
+    std::shared_ptr<const std::string> get(ParkingSystem& ps, const StateSnapshot& snap, std::string& etag);
+
+    unsigned long getZoneRenders();
+    unsigned long getRequestRenders();
+};
+
+// The same full document rendered straight from one pinned snapshot, a chunk at a time, for cities
+// too big to keep as one string. Memory per download is one chunk, whatever the city's size.
+class DataJsonStream {
+private:
+    enum Stage { HEADER, ZONES, REQUESTS, DONE };
+    std::shared_ptr<const StateSnapshot> snap;
+    long epoch;
+    Stage stage;
+    int zone; // Next zone, area and slot to write; -1 while the area or zone is not opened yet
+    int area;
+    int slot;
+    size_t request;
+    JsonWriter writer; // The current chunk, reused for the next one
+
+public:
+    DataJsonStream(std::shared_ptr<const StateSnapshot> snap, long epoch);
+
+    // Renders the next chunk, about chunkBytes (plus one slot or request) long; false once the document is complete
+    bool next(size_t chunkBytes);
+    const JsonWriter& chunk() const;
+};
+
+#endif // DATA_JSON_CACHE_H
@@ -0,0 +1,70 @@
+#include "EventHub.h"
+#include <algorithm>
+#include <chrono>
+
+EventSubscription::EventSubscription(size_t cap) : capacity(cap > 0 ? cap : 1), overflowed(false) {}
+
+EventHub::EventHub(size_t maxSubs) : sequence(0), resyncs(0), maxSubscribers(maxSubs), closed(false) {}
+
+std::shared_ptr<EventSubscription> EventHub::subscribe(size_t capacity) {
+    std::shared_ptr<EventSubscription> subscription = std::make_shared<EventSubscription>(capacity);
+    std::lock_guard<std::mutex> guard(lock);
+    if (subscribers.size() >= maxSubscribers) return nullptr;
+    subscribers.push_back(subscription);
+    return subscription;
+}
+
+void EventHub::unsubscribe(const std::shared_ptr<EventSubscription>& subscription) {
+    std::lock_guard<std::mutex> guard(lock);
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscription), subscribers.end());
+}
+
+void EventHub::publish(const char* type, const ParkingRequest& request) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (subscribers.empty()) return;
+    // One immutable copy shared by every queue
+    std::shared_ptr<const ParkingEvent> event(new ParkingEvent{++sequence, type, request});
+    for (const auto& subscription : subscribers) {
+        if (subscription->overflowed) continue;
+        if (subscription->queue.size() >= subscription->capacity) {
+            subscription->queue.clear();
+            subscription->overflowed = true;
+            resyncs++;
+        } else {
+            subscription->queue.push_back(event);
+        }
+        subscription->ready.notify_one();
+    }
+}
+
+EventHub::WaitResult EventHub::wait(EventSubscription& subscription, std::vector<std::shared_ptr<const ParkingEvent>>& out, int timeoutMs) {
+    out.clear();
+    std::unique_lock<std::mutex> guard(lock);
+    subscription.ready.wait_for(guard, std::chrono::milliseconds(timeoutMs),
+                                [&]() { return closed || subscription.overflowed || !subscription.queue.empty(); });
+    if (closed) return CLOSED;
+    if (subscription.overflowed) {
+        subscription.overflowed = false;
+        return RESYNC;
+    }
+    if (subscription.queue.empty()) return TIMEOUT;
+    out.assign(subscription.queue.begin(), subscription.queue.end());
+    subscription.queue.clear();
+    return EVENTS;
+}
+
+void EventHub::close() {
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    for (const auto& subscription : subscribers) subscription->ready.notify_all();
+}
+
+size_t EventHub::getSubscriberCount() {
+    std::lock_guard<std::mutex> guard(lock);
+    return subscribers.size();
+}
+
+unsigned long EventHub::getResyncCount() {
+    std::lock_guard<std::mutex> guard(lock);
+    return resyncs;
+}
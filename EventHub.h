@@ -0,0 +1,64 @@
+#ifndef EVENT_HUB_H
+#define EVENT_HUB_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ParkingRequest.h"
+
+// One request change pushed to subscribers (see ParkingSystem::setEventHub)
+struct ParkingEvent {
+    unsigned long sequence; // Increases by one per event
+    const char* type;       // "allocate", "cancel", "leave" or "rollback"
+    ParkingRequest request; // Image after the change
+};
+
+// Pending events of one subscriber, at most `capacity` of them. A subscriber that falls further behind
+// loses its queue and is told to resync, so a slow client never holds up the writers.
+class EventSubscription {
+private:
+    friend class EventHub;
+    std::deque<std::shared_ptr<const ParkingEvent>> queue;
+    size_t capacity;
+    bool overflowed;
+    std::condition_variable ready;
+
+public:
+    explicit EventSubscription(size_t capacity);
+};
+
+// Fan-out of request changes to any number of subscribers (the server's /api/events streams).
+// Publishing is O(subscribers) under one short lock and never waits for a subscriber.
+class EventHub {
+private:
+    std::mutex lock;
+    std::vector<std::shared_ptr<EventSubscription>> subscribers;
+    unsigned long sequence;
+    unsigned long resyncs; // Subscribers dropped for falling behind
+    size_t maxSubscribers;
+    bool closed;
+
+public:
+    enum WaitResult { EVENTS, TIMEOUT, RESYNC, CLOSED };
+
+    explicit EventHub(size_t maxSubscribers = SIZE_MAX);
+
+    // Null once maxSubscribers are registered; the check and the registration are one step
+    std::shared_ptr<EventSubscription> subscribe(size_t capacity);
+    void unsubscribe(const std::shared_ptr<EventSubscription>& subscription);
+    void publish(const char* type, const ParkingRequest& request);
+
+    // Waits up to timeoutMs for events and moves them into `out`. After RESYNC the subscription
+    // starts again from an empty queue.
+    WaitResult wait(EventSubscription& subscription, std::vector<std::shared_ptr<const ParkingEvent>>& out, int timeoutMs);
+    void close(); // Wakes every waiter with CLOSED
+
+    size_t getSubscriberCount();
+    unsigned long getResyncCount();
+};
+
+#endif // EVENT_HUB_H
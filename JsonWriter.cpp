@@ -0,0 +1,101 @@
+#include "JsonWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+template <typename T>
+void appendNumber(std::string& out, T value) {
+    char buf[32];
+    std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, r.ptr);
+}
+
+} // namespace
+
+void JsonWriter::clear() {
+    out.clear();
+}
+
+void JsonWriter::reserve(size_t bytes) {
+    out.reserve(bytes);
+}
+
+JsonWriter& JsonWriter::raw(const std::string& text) {
+    out.append(text);
+    return *this;
+}
+
+JsonWriter& JsonWriter::string(const std::string& s) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    size_t plain = 0; // Start of the run not yet copied
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(s, plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default: {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                out.append(esc, 6);
+            }
+        }
+    }
+    out.append(s, plain, s.size() - plain);
+    out += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(long long value) {
+    appendNumber(out, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(unsigned long long value) {
+    appendNumber(out, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(int value) {
+    appendNumber(out, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(long value) {
+    appendNumber(out, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(unsigned long value) {
+    appendNumber(out, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    if (!std::isfinite(value)) return raw("null"); // JSON has no NaN or infinity
+    appendNumber(out, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::boolean(bool value) {
+    return value ? raw("true") : raw("false");
+}
+
+const std::string& JsonWriter::str() const {
+    return out;
+}
+
+const char* JsonWriter::data() const {
+    return out.data();
+}
+
+size_t JsonWriter::size() const {
+    return out.size();
+}
@@ -0,0 +1,45 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstring>
+#include <string>
+
+// Appends JSON text to a buffer that is kept between uses: clear() empties it but keeps the capacity,
+// so a writer reused per handler thread stops allocating once it has grown to its largest response.
+// Numbers go through std::to_chars (no locale, no streams). The caller supplies the punctuation.
+class JsonWriter {
+private:
+    std::string out;
+
+public:
+    void clear();
+    void reserve(size_t bytes);
+
+    // Inline so the length of a literal is known at compile time
+    JsonWriter& raw(const char* text) {
+        out.append(text, std::strlen(text));
+        return *this;
+    }
+    JsonWriter& key(const char* name) { // "name": (names are never escaped)
+        out += '"';
+        out.append(name, std::strlen(name));
+        out.append("\": ", 3);
+        return *this;
+    }
+
+    JsonWriter& raw(const std::string& text);
+    JsonWriter& string(const std::string& s); // Quoted and escaped
+    JsonWriter& number(long long value);
+    JsonWriter& number(unsigned long long value);
+    JsonWriter& number(int value);
+    JsonWriter& number(long value);
+    JsonWriter& number(unsigned long value);
+    JsonWriter& number(double value);         // Shortest form that reads back exactly
+    JsonWriter& boolean(bool value);
+
+    const std::string& str() const;
+    const char* data() const;
+    size_t size() const;
+};
+
+#endif // JSON_WRITER_H
@@ -1,19 +1,39 @@
 #include "ParkingArea.h"
 
-ParkingArea::ParkingArea(int id) : areaId(id) {}
+ParkingArea::ParkingArea(CityLayout* c, int areaIndex) : city(c), index(areaIndex) {}
 
-void ParkingArea::addSlot(const ParkingSlot& slot) {
-    slots.push_back(slot);
+bool ParkingArea::addSlot(int slotId) {
+    return city->addSlot(index, slotId) != -1;
 }
 
-const std::vector<ParkingSlot>& ParkingArea::getSlots() const {
-    return slots;
+ViewRange<ParkingSlot> ParkingArea::getSlots() const {
+    return ViewRange<ParkingSlot>(city, city->getAreaSlotBegin(index), city->getAreaSlotEnd(index));
 }
 
-std::vector<ParkingSlot>& ParkingArea::getSlotsMutable() {
-    return slots;
+int ParkingArea::getAreaId() const {
+    return city->getAreaId(index);
 }
 
-int ParkingArea::getAreaId() const {
-    return areaId;
+int ParkingArea::getIndex() const {
+    return index;
+}
+
+int ParkingArea::getCapacity() const {
+    return city->getAreaCapacity(index);
+}
+
+int ParkingArea::getOccupiedCount() const {
+    return city->getAreaOccupied(index);
+}
+
+bool ParkingArea::isFull() const {
+    return getOccupiedCount() == getCapacity();
+}
+
+int ParkingArea::findFreeSlotIndex() const {
+    return city->findFreeSlot(index);
+}
+
+int ParkingArea::peekFreeList() const {
+    return city->peekFreeList(index);
 }
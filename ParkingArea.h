@@ -2,20 +2,31 @@
 #define PARKING_AREA_H
 
 #include <vector>
+#include "CityLayout.h"
 #include "ParkingSlot.h"
 
+// Lightweight view of one area in a CityLayout
 class ParkingArea {
 private:
-    int areaId;
-    std::vector<ParkingSlot> slots;
+    CityLayout* city;
+    int index; // Area index in the city's area columns
 
 public:
-    ParkingArea(int id);
+    ParkingArea(CityLayout* c, int areaIndex);
     
-    void addSlot(const ParkingSlot& slot);
-    const std::vector<ParkingSlot>& getSlots() const;
-    std::vector<ParkingSlot>& getSlotsMutable(); // Helper for modification
+    bool addSlot(int slotId); // False if rejected (not the last area, or duplicate slot ID)
+    ViewRange<ParkingSlot> getSlots() const;
     int getAreaId() const;
+    int getIndex() const;
+
+    // Live counters, O(1)
+    int getCapacity() const;
+    int getOccupiedCount() const;
+    bool isFull() const;
+
+    // Free-slot search, both return a global slot index or -1 if the area is full
+    int findFreeSlotIndex() const; // First free slot via find-first-zero on the bitmap
+    int peekFreeList() const;      // Most recently freed slot, O(1)
 };
 
 #endif // PARKING_AREA_H
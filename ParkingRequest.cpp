@@ -1,18 +1,32 @@
 #include "ParkingRequest.h"
 #include <iostream>
 
-int ParkingRequest::idCounter = 1;
+std::atomic<int> ParkingRequest::idCounter(1);
 
-ParkingRequest::ParkingRequest(std::string vId, int zoneId) 
-    : vehicleId(vId), requestedZoneId(zoneId), assignedSlotId(-1), state(RequestState::REQUESTED), endTime(0) {
+ParkingRequest::ParkingRequest(std::string vId, int zoneId) : ParkingRequest(vId, zoneId, std::time(nullptr)) {}
+
+ParkingRequest::ParkingRequest(std::string vId, int zoneId, time_t created)
+    : vehicleId(vId), requestedZoneId(zoneId), assignedSlotId(-1), assignedZoneId(-1), state(RequestState::REQUESTED), endTime(0) {
     requestId = idCounter++;
-    requestTime = std::time(nullptr);
+    requestTime = created;
+}
+
+ParkingRequest::ParkingRequest(int id, std::string vId, int zoneId, time_t created)
+    : ParkingRequest(id, vId, zoneId, created, true) {}
+
+ParkingRequest::ParkingRequest(int id, std::string vId, int zoneId, time_t created, bool reserveId)
+    : requestId(id), vehicleId(vId), requestedZoneId(zoneId), assignedSlotId(-1), assignedZoneId(-1),
+      requestTime(created), endTime(0), state(RequestState::REQUESTED) {
+    if (!reserveId) return;
+    int next = idCounter.load();
+    while (next <= id && !idCounter.compare_exchange_weak(next, id + 1)) {}
 }
 
 int ParkingRequest::getRequestId() const { return requestId; }
 std::string ParkingRequest::getVehicleId() const { return vehicleId; }
 int ParkingRequest::getRequestedZoneId() const { return requestedZoneId; }
 int ParkingRequest::getAssignedSlotId() const { return assignedSlotId; }
+int ParkingRequest::getAssignedZoneId() const { return assignedZoneId; }
 RequestState ParkingRequest::getState() const { return state; }
 time_t ParkingRequest::getRequestTime() const { return requestTime; }
 time_t ParkingRequest::getEndTime() const { return endTime; }
@@ -22,8 +36,9 @@ double ParkingRequest::getDuration() const {
     return difftime(endTime, requestTime);
 }
 
-void ParkingRequest::assignSlot(int slotId) {
+void ParkingRequest::assignSlot(int slotId, int zoneId) {
     assignedSlotId = slotId;
+    assignedZoneId = zoneId;
 }
 
 void ParkingRequest::setEndTime(time_t time) {
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <ctime>
+#include <atomic>
 
 enum class RequestState {
     REQUESTED,
@@ -14,28 +15,35 @@ enum class RequestState {
 
 class ParkingRequest {
 private:
-    static int idCounter;
+    static std::atomic<int> idCounter; // Atomic so concurrent handlers never share an ID
     int requestId;
     std::string vehicleId;
     int requestedZoneId;
     int assignedSlotId; //-1 if not assigned
+    int assignedZoneId; //-1 if not assigned, may differ from requestedZoneId (cross-zone)
     time_t requestTime;
     time_t endTime; // For duration
     RequestState state;
 
 public:
     ParkingRequest(std::string vId, int zoneId);
+    ParkingRequest(std::string vId, int zoneId, time_t created); // With the creation time from ParkingSystem's clock
+    // Recreates a persisted request (log replay) with its original ID; new IDs continue after it
+    ParkingRequest(int id, std::string vId, int zoneId, time_t created);
+    // With reserveId false, a read-only copy (e.g. decoded by an archive scan) that leaves the ID counter alone
+    ParkingRequest(int id, std::string vId, int zoneId, time_t created, bool reserveId);
 
     int getRequestId() const;
     std::string getVehicleId() const;
     int getRequestedZoneId() const;
     int getAssignedSlotId() const;
+    int getAssignedZoneId() const;
     RequestState getState() const;
     time_t getRequestTime() const;
     time_t getEndTime() const;
     double getDuration() const; // In seconds
 
-    void assignSlot(int slotId);
+    void assignSlot(int slotId, int zoneId);
     void setEndTime(time_t time);
     bool transitionTo(RequestState newState); // Returns false if invalid
     void forceState(RequestState newState); // For rollback/admin use
@@ -1,23 +1,27 @@
 #include "ParkingSlot.h"
 
-ParkingSlot::ParkingSlot(int sId, int zId) : slotId(sId), zoneId(zId), occupied(false) {}
+ParkingSlot::ParkingSlot(CityLayout* c, int slotIndex) : city(c), index(slotIndex) {}
 
 int ParkingSlot::getSlotId() const {
-    return slotId;
+    return city->getSlotId(index);
 }
 
 int ParkingSlot::getZoneId() const {
-    return zoneId;
+    return city->getZoneId(city->getSlotZone(index));
 }
 
 bool ParkingSlot::isOccupied() const {
-    return occupied;
+    return city->isOccupied(index);
 }
 
-void ParkingSlot::occupy() {
-    occupied = true;
+int ParkingSlot::getIndex() const {
+    return index;
 }
 
-void ParkingSlot::release() {
-    occupied = false;
+bool ParkingSlot::occupy() {
+    return city->occupySlot(index); // Also updates bitmap, free list and counters
+}
+
+bool ParkingSlot::release() {
+    return city->releaseSlot(index);
 }
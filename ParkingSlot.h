@@ -2,22 +2,24 @@
 #define PARKING_SLOT_H
 
 #include <string>
+#include "CityLayout.h"
 
+// Lightweight view of one slot in a CityLayout (copy freely, 16 bytes)
 class ParkingSlot {
 private:
-    int slotId;
-    int zoneId;
-    bool occupied;
+    CityLayout* city;
+    int index; // Global slot index in the city's slot columns
 
 public:
-    ParkingSlot(int sId, int zId);
+    ParkingSlot(CityLayout* c, int slotIndex);
 
     int getSlotId() const;
     int getZoneId() const;
     bool isOccupied() const;
+    int getIndex() const;
     
-    void occupy();
-    void release();
+    bool occupy();  // False if the slot was already taken (e.g. by another thread)
+    bool release();
 };
 
 #endif // PARKING_SLOT_H
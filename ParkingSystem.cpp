@@ -1,196 +1,1017 @@
 #include "ParkingSystem.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
 
-ParkingSystem::ParkingSystem() {}
+namespace {
 
-void ParkingSystem::addZone(const Zone& zone) {
-    zones.push_back(zone);
+time_t systemClock() {
+    return std::time(nullptr);
 }
 
-const std::vector<Zone>& ParkingSystem::getZones() const {
-    return zones;
+} // namespace
+
+ParkingSystem::ParkingSystem()
+    : firstRequestId(0), concurrent(false), collectingUndo(false), logging(true), snapshotVersion(0), mutationCount(0), snapshotOnCommit(false),
+      requestsCompacted(false), clock(systemClock), logGeneration(0), checkpointGeneration(0) {}
+
+void ParkingSystem::enableConcurrency() {
+    concurrent = true;
+    city.setZoneLocking(true);
+}
+
+void ParkingSystem::enableLockFreeClaiming() {
+    enableConcurrency();
+    city.setLockFreeClaiming(true);
+}
+
+void ParkingSystem::setLogging(bool enabled) {
+    logging = enabled;
+}
+
+std::shared_lock<std::shared_mutex> ParkingSystem::enterCommit() {
+    std::shared_lock<std::shared_mutex> gate(commitGate.m, std::defer_lock);
+    if (concurrent) gate.lock();
+    return gate;
+}
+
+void ParkingSystem::committed() {
+    mutationCount.value++;
+    if (snapshotOnCommit) publishSnapshot();
+}
+
+std::unique_lock<std::mutex> ParkingSystem::lockRequests() {
+    std::unique_lock<std::mutex> lock(requestsLock.m, std::defer_lock);
+    if (concurrent) lock.lock();
+    return lock;
+}
+
+std::unique_lock<std::mutex> ParkingSystem::lockHistory() {
+    std::unique_lock<std::mutex> lock(historyLock.m, std::defer_lock);
+    if (concurrent) lock.lock();
+    return lock;
+}
+
+void ParkingSystem::logOperation(const Operation& op) {
+    auto history = lockHistory();
+    rollbackManager.logOperation(op);
+    if (wal) wal->appendOperation(op); // Same order as the history ring
+}
+
+void ParkingSystem::setEventHub(std::shared_ptr<EventHub> hub) {
+    events = hub;
+}
+
+void ParkingSystem::requestChanged(const ParkingRequest& req, const char* eventType) {
+    if (wal) {
+        if (collectingUndo) undoImages.push_back(req); // Logged with the rollback record
+        else wal->appendRequest(req);
+    }
+    if (events) events->publish(eventType, req); // Under requestsLock, so sequence order is table order
+    size_t pos = (size_t)(&req - requests.data());
+    requestIndex.update((int)pos, req);
+    if (pos >= requestDirty.size()) requestDirty.resize(requests.size(), 0);
+    if (!requestDirty[pos]) {
+        requestDirty[pos] = 1;
+        dirtyRequests.push_back((int)pos);
+    }
+}
+
+std::string ParkingSystem::segmentPath(unsigned long generation) const {
+    return walPath + "." + std::to_string(generation);
+}
+
+bool ParkingSystem::openWriteAheadLog(const std::string& path, int groupRecords, int groupMs) {
+    walPath = path;
+    logGeneration = checkpointGeneration;
+    if (checkpointGeneration > 0) std::remove(segmentPath(checkpointGeneration - 1).c_str()); // Left over if we crashed mid-checkpoint
+
+    // Segments rotated away by checkpoints whose image never made it to disk, oldest first
+    std::vector<char> touched(requests.size(), 0);
+    for (unsigned long g = checkpointGeneration;; ++g) {
+        WalReader reader(segmentPath(g));
+        if (!reader.isOpen()) break;
+        replayLog(reader, touched);
+        oldSegments.push_back(segmentPath(g));
+        logGeneration = g + 1;
+    }
+    long validLength;
+    {
+        WalReader reader(path);
+        // Anything after the valid length is a torn write from a crash; a stale segment is dropped whole
+        validLength = replayLog(reader, touched) ? reader.getValidLength() : 0;
+    }
+
+    // Occupancy and indexes follow from the final image of every request the log touched
+    int active = 0;
+    for (size_t pos = 0; pos < touched.size(); ++pos) {
+        const ParkingRequest& req = requests[pos];
+        if (touched[pos]) requestIndex.update((int)pos, req);
+        if (!touched[pos] || (req.getState() != RequestState::ALLOCATED && req.getState() != RequestState::OCCUPIED)) continue;
+        int s = city.findSlotIndex(req.getAssignedSlotId());
+        if (s != -1 && city.occupySlot(s)) active++;
+    }
+    if (logging && std::count(touched.begin(), touched.end(), 1) > 0) {
+        std::cout << "[System] Recovered " << std::count(touched.begin(), touched.end(), 1) << " requests (" << active
+                  << " active allocations) from write-ahead log" << std::endl;
+    }
+
+    std::shared_ptr<WriteAheadLog> log = std::make_shared<WriteAheadLog>();
+    if (!log->open(path, validLength, groupRecords, groupMs)) {
+        std::cout << "[System] Cannot open write-ahead log " << path << std::endl;
+        return false;
+    }
+    if (validLength == 0) log->appendSegmentHeader(logGeneration);
+    wal = log;
+    committed();
+    return true;
+}
+
+bool ParkingSystem::syncWriteAheadLog() {
+    return !wal || wal->sync();
+}
+
+bool ParkingSystem::replayLog(WalReader& reader, std::vector<char>& touched) {
+    WalRecord rec;
+    bool first = true;
+    while (reader.next(rec)) {
+        if (first && rec.type == WalRecord::SEGMENT && rec.generation < checkpointGeneration) return false;
+        first = false;
+
+        if (rec.type == WalRecord::REQUEST) {
+            replayImage(rec, touched);
+        } else if (rec.type == WalRecord::OPERATION) {
+            Operation op = rec.op;
+            op.slotIndex = city.findSlotIndex(op.slotId);
+            ParkingRequest* req = findRequest(op.requestId);
+            if (op.slotIndex == -1 || !req) continue; // City layout changed since the log was written
+            op.requestPos = (int)(req - requests.data());
+            rollbackManager.logOperation(op);
+        } else if (rec.type == WalRecord::ROLLBACK) {
+            rollbackManager.rollback(rec.count);
+            for (const WalRecord& image : rec.images) replayImage(image, touched);
+        }
+    }
+    return true;
+}
+
+void ParkingSystem::replayImage(const WalRecord& rec, std::vector<char>& touched) {
+    // Images are complete, so the last one per request wins
+    ParkingRequest* req = findRequest(rec.requestId);
+    if (!req) {
+        int pos = storeRequest(ParkingRequest(rec.requestId, rec.vehicleId, rec.requestedZoneId, rec.requestTime));
+        req = &requests[pos];
+    }
+    size_t pos = (size_t)(req - requests.data());
+    if (pos >= touched.size()) touched.resize(requests.size(), 0);
+    if (!touched[pos]) {
+        // First change since the image: give its slot back, the final image decides
+        touched[pos] = 1;
+        if (req->getState() == RequestState::ALLOCATED || req->getState() == RequestState::OCCUPIED) {
+            int s = city.findSlotIndex(req->getAssignedSlotId());
+            if (s != -1) city.releaseSlot(s);
+        }
+    }
+    req->forceState(rec.state);
+    req->assignSlot(rec.slotId, rec.zoneId);
+    req->setEndTime(rec.endTime);
+}
+
+void ParkingSystem::encodeImage(CityImageWriter& image, CityImageHeader& header) {
+    std::vector<int> adjacencyBegin;
+    std::vector<int> adjacency;
+    CityColumns c = city.getColumns(adjacencyBegin, adjacency);
+    image.append(c.zoneIds, c.zoneCount);
+    image.append(c.zoneAreaBegin, c.zoneCount + 1);
+    image.append(c.adjacencyBegin, c.zoneCount + 1);
+    image.append(c.adjacency, adjacency.size());
+    image.append(c.areaIds, c.areaCount);
+    image.append(c.areaSlotBegin, c.areaCount + 1);
+    image.append(c.slotIds, c.slotCount);
+    image.append(c.occupancy, (c.slotCount + 63) / 64);
+
+    std::vector<RequestImage> records(requests.size());
+    std::string vehicles;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const ParkingRequest& req = requests[i];
+        RequestImage& r = records[i];
+        r.requestId = req.getRequestId();
+        r.requestedZoneId = req.getRequestedZoneId();
+        r.state = (std::int32_t)req.getState();
+        r.slotId = req.getAssignedSlotId();
+        r.zoneId = req.getAssignedZoneId();
+        r.vehicleOffset = (std::uint32_t)vehicles.size();
+        r.vehicleLength = (std::uint32_t)req.getVehicleId().size();
+        r.padding = 0;
+        r.requestTime = req.getRequestTime();
+        r.endTime = req.getEndTime();
+        vehicles += req.getVehicleId();
+    }
+    image.append(records.data(), records.size());
+    image.append(vehicles.data(), vehicles.size());
+
+    // History oldest first, so restoring is a plain sequence of logOperation calls
+    RollbackView history = rollbackManager.peek((int)rollbackManager.size());
+    std::vector<OperationImage> ops(history.size());
+    for (size_t i = 0; i < history.size(); ++i) {
+        const Operation& op = history[history.size() - 1 - i];
+        ops[i] = OperationImage{(std::int32_t)op.type, op.requestId, op.slotId, op.zoneId};
+    }
+    image.append(ops.data(), ops.size());
+    std::vector<char> archived;
+    archive.encode(archived);
+    image.append(archived.data(), archived.size());
+
+    header = CityImageHeader();
+    header.zoneCount = c.zoneCount;
+    header.areaCount = c.areaCount;
+    header.slotCount = c.slotCount;
+    header.adjacencyCount = adjacency.size();
+    header.requestCount = records.size();
+    header.vehicleBytes = vehicles.size();
+    header.operationCount = ops.size();
+    header.rollbackDepth = rollbackManager.getDepth();
+    header.rollbackDropped = rollbackManager.getDroppedCount();
+    header.archiveBytes = archived.size();
+    header.archiveDropped = archive.getDroppedCount();
+}
+
+bool ParkingSystem::writeCheckpoint(const std::string& imagePath) {
+    std::lock_guard<std::mutex> checkpointing(checkpointLock.m);
+    CityImageWriter image;
+    CityImageHeader header;
+    {
+        // Like publishSnapshot: the image falls between whole operations (O(slots/64 + requests) copy)
+        std::unique_lock<std::shared_mutex> gate(commitGate.m, std::defer_lock);
+        if (concurrent) gate.lock();
+        encodeImage(image, header);
+        // Everything logged so far is in the image; later changes go to a new segment
+        if (wal) {
+            if (!wal->rotate(segmentPath(logGeneration), logGeneration + 1)) {
+                std::cout << "[System] Cannot rotate write-ahead log " << walPath << std::endl;
+                return false;
+            }
+            oldSegments.push_back(segmentPath(logGeneration));
+        }
+        logGeneration++;
+        header.generation = logGeneration;
+    }
+
+    // Written with writers running again; a crash before the rename keeps the old image and all segments
+    if (!image.writeFile(imagePath, header)) {
+        std::cout << "[System] Cannot write checkpoint " << imagePath << std::endl;
+        return false;
+    }
+    checkpointGeneration = header.generation;
+    for (const std::string& segment : oldSegments) std::remove(segment.c_str());
+    oldSegments.clear();
+    if (logging) {
+        std::cout << "[System] Checkpoint " << header.generation << " written: " << header.slotCount << " slots, "
+                  << header.requestCount << " requests, " << image.size() << " bytes" << std::endl;
+    }
+    return true;
+}
+
+namespace {
+
+// Private (unshared) resident memory of this process, 0 where /proc/self/smaps_rollup is unavailable
+long privateMemoryKB() {
+    std::ifstream in("/proc/self/smaps_rollup");
+    std::string line;
+    long total = 0;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 8, "Private_") != 0) continue;
+        std::istringstream fields(line.substr(line.find(':') + 1));
+        long kb = 0;
+        fields >> kb;
+        total += kb;
+    }
+    return total;
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+bool ParkingSystem::forkBackup(const std::string& imagePath, BackupStats& stats) {
+    struct ChildReport {
+        bool ok;
+        long imageBytes;
+    };
+    stats = BackupStats{0, 0, 0, 0, false};
+    std::unique_lock<std::mutex> serial(backupLock.m, std::try_to_lock);
+    if (!serial.owns_lock()) {
+        stats.busy = true;
+        return false;
+    }
+    int toParent[2];
+    int toChild[2];
+    if (::pipe(toParent) != 0) return false;
+    if (::pipe(toChild) != 0) {
+        ::close(toParent[0]);
+        ::close(toParent[1]);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    {
+        // Fork between whole operations, exactly where publishSnapshot would cut
+        std::unique_lock<std::shared_mutex> gate(commitGate.m, std::defer_lock);
+        if (concurrent) gate.lock();
+        pid = ::fork();
+        if (pid == 0) {
+            // Child: only this thread exists, holding a frozen copy of the system. Nothing here may take a
+            // lock another thread could have held at the fork, and _exit skips every destructor.
+            ::close(toParent[0]);
+            ::close(toChild[1]);
+            CityImageWriter image;
+            CityImageHeader header;
+            encodeImage(image, header);
+            header.generation = 0;
+            ChildReport report{image.writeFile(imagePath, header), (long)image.size()};
+            ssize_t sent = ::write(toParent[1], &report, sizeof(report));
+            char done;
+            ssize_t got = ::read(toChild[0], &done, 1); // Stay alive until the parent has measured its copies
+            (void)sent;
+            (void)got;
+            ::_exit(report.ok ? 0 : 1);
+        }
+    }
+    stats.pauseMs = msSince(start);
+    ::close(toParent[1]);
+    ::close(toChild[0]);
+    if (pid == -1) {
+        ::close(toParent[0]);
+        ::close(toChild[1]);
+        std::cout << "[System] Backup fork failed" << std::endl;
+        return false;
+    }
+
+    // Right after the fork every page is shared; whatever turns private from here on was copied for us
+    long privateAtFork = privateMemoryKB();
+    ChildReport report{false, 0};
+    bool reported = ::read(toParent[0], &report, sizeof(report)) == (ssize_t)sizeof(report);
+    stats.duplicatedKB = std::max(0L, privateMemoryKB() - privateAtFork); // Pages we freed meanwhile can make it negative
+    stats.totalMs = msSince(start);
+    ::close(toChild[1]);
+    ::close(toParent[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+
+    bool ok = reported && report.ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    stats.imageBytes = report.imageBytes;
+    if (logging) {
+        std::cout << "[System] Backup to " << imagePath << (ok ? " written" : " failed") << ": paused " << stats.pauseMs << " ms, "
+                  << stats.totalMs << " ms total, " << stats.duplicatedKB << " KB copied-on-write" << std::endl;
+    }
+    return ok;
+}
+
+bool ParkingSystem::loadCheckpoint(const std::string& imagePath) {
+    if (city.getZoneCount() > 0 || !requests.empty()) return false;
+    MappedCityImage image(imagePath);
+    if (!image.isValid()) return false;
+    const CityImageHeader& h = image.getHeader();
+
+    static_assert(sizeof(int) == sizeof(std::int32_t), "image columns are 32-bit");
+    CityColumns c;
+    c.zoneCount = (int)h.zoneCount;
+    c.areaCount = (int)h.areaCount;
+    c.slotCount = (int)h.slotCount;
+    c.zoneIds = image.next<int>(h.zoneCount);
+    c.zoneAreaBegin = image.next<int>(h.zoneCount + 1);
+    c.adjacencyBegin = image.next<int>(h.zoneCount + 1);
+    c.adjacency = image.next<int>(h.adjacencyCount);
+    c.areaIds = image.next<int>(h.areaCount);
+    c.areaSlotBegin = image.next<int>(h.areaCount + 1);
+    c.slotIds = image.next<int>(h.slotCount);
+    c.occupancy = image.next<std::uint64_t>((h.slotCount + 63) / 64);
+    const RequestImage* records = image.next<RequestImage>(h.requestCount);
+    const char* vehicles = image.next<char>(h.vehicleBytes);
+    const OperationImage* ops = image.next<OperationImage>(h.operationCount);
+    const char* archived = image.next<char>(h.archiveBytes);
+    if (!archived || !ops || !vehicles || !records || !c.occupancy || !c.slotIds || !c.areaSlotBegin || !c.areaIds || !c.adjacency ||
+        !c.adjacencyBegin || !c.zoneAreaBegin || !c.zoneIds || (size_t)c.adjacencyBegin[c.zoneCount] != h.adjacencyCount ||
+        !archive.decode(archived, h.archiveBytes, (unsigned long)h.archiveDropped) || !city.loadColumns(c)) {
+        std::cout << "[System] Checkpoint " << imagePath << " is inconsistent, ignoring it" << std::endl;
+        return false;
+    }
+
+    requests.reserve(h.requestCount);
+    requestIndex.reserve(h.requestCount);
+    for (size_t i = 0; i < h.requestCount; ++i) {
+        const RequestImage& r = records[i];
+        if ((size_t)r.vehicleOffset + r.vehicleLength > h.vehicleBytes) continue;
+        ParkingRequest req(r.requestId, std::string(vehicles + r.vehicleOffset, r.vehicleLength), r.requestedZoneId, (time_t)r.requestTime);
+        req.forceState((RequestState)r.state);
+        req.assignSlot(r.slotId, r.zoneId);
+        req.setEndTime((time_t)r.endTime);
+        storeRequest(std::move(req));
+    }
+
+    rollbackManager.setDepth((size_t)h.rollbackDepth);
+    for (size_t i = 0; i < h.operationCount; ++i) {
+        Operation op{(Operation::Type)ops[i].type, ops[i].requestId, ops[i].slotId, ops[i].zoneId, -1, -1};
+        op.slotIndex = city.findSlotIndex(op.slotId);
+        ParkingRequest* req = findRequest(op.requestId);
+        if (op.slotIndex == -1 || !req) continue;
+        op.requestPos = (int)(req - requests.data());
+        rollbackManager.logOperation(op);
+    }
+    rollbackManager.setDroppedCount((unsigned long)h.rollbackDropped);
+
+    checkpointGeneration = (unsigned long)h.generation;
+    if (logging) {
+        std::cout << "[System] Loaded checkpoint " << checkpointGeneration << ": " << c.zoneCount << " zones, " << c.slotCount
+                  << " slots, " << h.requestCount << " requests, " << archive.getRecordCount() << " archived" << std::endl;
+    }
+    committed();
+    return true;
+}
+
+Zone ParkingSystem::addZone(int zoneId) {
+    int z = city.addZone(zoneId);
+    if (z == -1) std::cout << "[System] Zone " << zoneId << " already exists" << std::endl;
+    return Zone(&city, z);
+}
+
+ViewRange<Zone> ParkingSystem::getZones() {
+    return ViewRange<Zone>(&city, 0, city.getZoneCount());
 }
 
 const std::vector<ParkingRequest>& ParkingSystem::getRequests() const {
     return requests;
 }
 
-ParkingSlot* ParkingSystem::findSlotById(int slotId, int zoneId) {
-    for (auto& z : zones) {
-        if (z.getZoneId() == zoneId) {
-            for (auto& area : z.getParkingAreasMutable()) {
-                for (auto& slot : area.getSlotsMutable()) {
-                    if (slot.getSlotId() == slotId) return &slot;
-                }
+std::shared_ptr<const StateSnapshot> ParkingSystem::getSnapshot() {
+    std::shared_ptr<const StateSnapshot> current = std::atomic_load(&snapshot);
+    if (current) return current;
+    publishSnapshot();
+    return std::atomic_load(&snapshot);
+}
+
+bool ParkingSystem::getChangesSince(unsigned long since, const StateSnapshot& snap, std::vector<int>& slots, std::vector<int>& requests) {
+    return changeLog.collect(since, snap.getVersion(), slots, requests);
+}
+
+void ParkingSystem::publishSnapshot() {
+    std::lock_guard<std::mutex> publishing(publishLock.m);
+    std::shared_ptr<StateSnapshot> next = std::make_shared<StateSnapshot>();
+    bool layoutChanged;
+    bool requestsMoved;
+    std::vector<int> changedRequests;
+    {
+        // Wait for in-flight mutations to finish and hold new ones back for the copy (O(slots/64 + requests))
+        std::unique_lock<std::shared_mutex> gate(commitGate.m, std::defer_lock);
+        if (concurrent) gate.lock();
+
+        // The city only grows, so equal counts mean the structure is unchanged and can be shared
+        layoutChanged = !snapshotLayout || (int)snapshotLayout->slotIds.size() != city.getSlotCount() ||
+            (int)snapshotLayout->areaIds.size() != city.getAreaCount() || (int)snapshotLayout->zoneIds.size() != city.getZoneCount();
+        if (layoutChanged) {
+            std::shared_ptr<SnapshotLayout> layout = std::make_shared<SnapshotLayout>();
+            for (int z = 0; z < city.getZoneCount(); ++z) {
+                layout->zoneIds.push_back(city.getZoneId(z));
+                layout->zoneAreaBegin.push_back(city.getZoneAreaBegin(z));
+            }
+            layout->zoneAreaBegin.push_back(city.getAreaCount());
+            for (int a = 0; a < city.getAreaCount(); ++a) {
+                layout->areaIds.push_back(city.getAreaId(a));
+                layout->areaSlotBegin.push_back(city.getAreaSlotBegin(a));
+            }
+            layout->areaSlotBegin.push_back(city.getSlotCount());
+            for (int s = 0; s < city.getSlotCount(); ++s) layout->slotIds.push_back(city.getSlotId(s));
+            snapshotLayout = layout;
+        }
+        next->layout = snapshotLayout;
+        city.copyOccupancy(next->occupancyBits);
+        next->requests = requests;
+        next->mutationCount = mutationCount.value.load();
+        changedRequests.swap(dirtyRequests);
+        for (int pos : changedRequests) requestDirty[pos] = 0;
+        requestsMoved = requestsCompacted;
+        requestsCompacted = false;
+    }
+    next->countOccupancy();
+    next->version = ++snapshotVersion;
+
+    // Stamp this version's changes before anyone can see it
+    std::shared_ptr<const StateSnapshot> previous = std::atomic_load(&snapshot);
+    if (layoutChanged || requestsMoved || !previous) {
+        changeLog.reset(next->version - 1); // Slot indices or request positions may have moved: older clients resync
+    } else {
+        std::vector<int> changedSlots;
+        for (size_t w = 0; w < next->occupancyBits.size(); ++w) {
+            std::uint64_t diff = next->occupancyBits[w] ^ previous->occupancyBits[w];
+            while (diff) {
+                changedSlots.push_back((int)(w * 64) + __builtin_ctzll(diff));
+                diff &= diff - 1;
             }
         }
+        changeLog.record(next->version, changedSlots, changedRequests);
+    }
+    std::atomic_store(&snapshot, std::shared_ptr<const StateSnapshot>(next));
+}
+
+void ParkingSystem::setSnapshotOnCommit(bool enabled) {
+    snapshotOnCommit = enabled;
+}
+
+unsigned long ParkingSystem::getMutationCount() const {
+    return mutationCount.value.load();
+}
+
+int ParkingSystem::storeRequest(ParkingRequest req) {
+    // IDs come from the monotonic ParkingRequest::idCounter, so (id - first id) is a dense offset.
+    // Gaps (IDs handed out to another ParkingSystem) stay -1.
+    if (requests.empty()) firstRequestId = req.getRequestId();
+    if (req.getRequestId() < firstRequestId) {
+        // Concurrent callers may store slightly out of ID order (or a log replays older IDs): grow the table downwards
+        requestPosById.insert(requestPosById.begin(), (size_t)(firstRequestId - req.getRequestId()), -1);
+        firstRequestId = req.getRequestId();
+    }
+    size_t offset = (size_t)(req.getRequestId() - firstRequestId);
+    if (offset >= requestPosById.size()) requestPosById.resize(offset + 1, -1);
+    int pos = (int)requests.size();
+    requestPosById[offset] = pos;
+    requests.push_back(std::move(req));
+    requestIndex.add(pos, requests[pos]);
+    return pos;
+}
+
+ParkingRequest* ParkingSystem::findRequest(int requestId) {
+    // Positions (not pointers) are stored, so lookups stay valid while requests grows
+    if (requests.empty() || requestId < firstRequestId) return nullptr;
+    size_t offset = (size_t)(requestId - firstRequestId);
+    if (offset >= requestPosById.size() || requestPosById[offset] < 0) return nullptr; // Absent or archived
+    return &requests[requestPosById[offset]];
+}
+
+bool ParkingSystem::queryRequests(const RequestQuery& query, std::vector<ParkingRequest>& page, int& nextCursor) {
+    page.clear();
+    nextCursor = -1;
+    std::vector<int> positions;
+    auto lock = lockRequests();
+    int afterPos = -1;
+    if (query.afterRequestId != -1) {
+        if (query.afterRequestId <= 0) return false;
+        // Below the table: archived, and every hot request was stored after it
+        if (!requests.empty() && query.afterRequestId >= firstRequestId) {
+            size_t offset = (size_t)(query.afterRequestId - firstRequestId);
+            if (offset >= requestPosById.size() || requestPosById[offset] == -1) return false;
+            int v = requestPosById[offset];
+            afterPos = v >= 0 ? v : -2 - v - 1; // An archived cursor resumes at its insertion point
+        }
     }
-    return nullptr;
+    requestIndex.query(query, afterPos, requests, positions);
+    page.reserve(positions.size());
+    for (int pos : positions) page.push_back(requests[pos]);
+    if ((int)page.size() == query.limit) nextCursor = page.back().getRequestId();
+    return true;
 }
 
 int ParkingSystem::requestParking(std::string vehicleId, int preferredZoneId) {
-    ParkingRequest req(vehicleId, preferredZoneId);
+    int requestId;
+    {
+        auto gate = enterCommit();
+        requestId = applyRequest(vehicleId, preferredZoneId);
+    }
+    committed();
+    return requestId;
+}
+
+std::vector<int> ParkingSystem::requestParkingBatch(const std::vector<ParkingRequestSpec>& batch) {
+    std::vector<int> ids;
+    {
+        auto gate = enterCommit();
+        ids = applyBatch(batch);
+    }
+    if (!ids.empty()) committed();
+    return ids;
+}
+
+bool ParkingSystem::cancelRequest(int requestId) {
+    bool ok;
+    {
+        auto gate = enterCommit();
+        ok = applyCancel(requestId);
+    }
+    if (ok) committed();
+    return ok;
+}
+
+bool ParkingSystem::leaveParking(int requestId) {
+    bool ok;
+    {
+        auto gate = enterCommit();
+        ok = applyLeave(requestId);
+    }
+    if (ok) committed();
+    return ok;
+}
+
+void ParkingSystem::rollbackOperations(int k) {
+    {
+        // Exclusive, unlike other mutations: nothing may be logged between the pop and the record carrying
+        // the undo, or replay would pop different operations. Rollbacks are rare and O(k).
+        std::unique_lock<std::shared_mutex> gate(commitGate.m, std::defer_lock);
+        if (concurrent) gate.lock();
+        applyRollback(k);
+    }
+    committed();
+}
+
+int ParkingSystem::applyRequest(const std::string& vehicleId, int preferredZoneId) {
+    ParkingRequest req(vehicleId, preferredZoneId, clock());
     
     // Transition to ALLOCATED via Engine
-    AllocationResult res = AllocationEngine::allocateSlot(preferredZoneId, zones);
+    AllocationResult res = AllocationEngine::allocateSlot(preferredZoneId, city);
     
+    int requestId = req.getRequestId();
     if (res.success) {
         req.transitionTo(RequestState::ALLOCATED);
-        req.assignSlot(res.slotId);
-        
+        req.assignSlot(res.slotId, res.zoneId);
+    }
+    int pos;
+    {
+        auto lock = lockRequests();
+        pos = storeRequest(std::move(req));
+        requestChanged(requests[pos], "allocate");
+    }
+
+    if (res.success) {
         Operation op;
         op.type = Operation::ALLOCATE;
-        op.requestId = req.getRequestId();
+        op.requestId = requestId;
         op.slotId = res.slotId;
         op.zoneId = res.zoneId;
-        rollbackManager.logOperation(op);
-        
+        op.slotIndex = city.findSlotIndex(res.slotId);
+        op.requestPos = pos;
+        logOperation(op);
+    }
+
+    if (!logging) return requestId;
+    if (res.success) {
         std::cout << "[System] Vehicle " << vehicleId << " allocated to Slot " << res.slotId 
                   << " in Zone " << res.zoneId 
-                  << (res.isCrossZone ? " (Cross-zone)" : "") << std::endl;
+                  << (res.isCrossZone ? " (Cross-zone" : "")
+                  << (res.hops > 1 ? ", " + std::to_string(res.hops) + " hops" : "")
+                  << (res.isCrossZone ? ")" : "") << std::endl;
     } else {
         std::cout << "[System] Failed to allocate parking for Vehicle " << vehicleId << std::endl;
     }
+    return requestId;
+}
+
+std::vector<int> ParkingSystem::applyBatch(const std::vector<ParkingRequestSpec>& batch) {
+    std::vector<int> ids;
+    ids.reserve(batch.size());
+    if (batch.empty()) return ids;
+
+    // Requests are created (and numbered) in input order
+    std::vector<ParkingRequest> created;
+    created.reserve(batch.size());
+    time_t now = clock();
+    for (const auto& spec : batch) {
+        created.emplace_back(spec.vehicleId, spec.zoneId, now);
+        ids.push_back(created.back().getRequestId());
+    }
+
+    // Group by zone (stable, so earlier arrivals in a zone get served first)
+    std::vector<int> order(batch.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = (int)i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return batch[a].zoneId < batch[b].zoneId; });
 
-    requests.push_back(req);
-    return req.getRequestId();
+    std::vector<AllocationResult> results(batch.size());
+    std::vector<AllocationResult> zoneResults;
+    for (size_t start = 0; start < order.size();) {
+        size_t end = start;
+        while (end < order.size() && batch[order[end]].zoneId == batch[order[start]].zoneId) end++;
+
+        zoneResults.clear();
+        AllocationEngine::allocateBatch(batch[order[start]].zoneId, (int)(end - start), city, zoneResults);
+        for (size_t i = start; i < end; ++i) results[order[i]] = zoneResults[i - start];
+        start = end;
+    }
+
+    int allocated = 0;
+    int crossZone = 0;
+    std::vector<int> positions;
+    {
+        // Storage is reserved once for the whole batch
+        positions.resize(created.size());
+        auto lock = lockRequests();
+        requests.reserve(requests.size() + batch.size());
+        requestPosById.reserve(requestPosById.size() + batch.size());
+        requestIndex.reserve(requests.size() + batch.size());
+        for (size_t i = 0; i < created.size(); ++i) {
+            if (results[i].success) {
+                created[i].transitionTo(RequestState::ALLOCATED);
+                created[i].assignSlot(results[i].slotId, results[i].zoneId);
+                allocated++;
+                if (results[i].isCrossZone) crossZone++;
+            }
+            positions[i] = storeRequest(std::move(created[i]));
+            requestChanged(requests[positions[i]], "allocate");
+        }
+    }
+    {
+        auto history = lockHistory();
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (!results[i].success) continue;
+            Operation op;
+            op.type = Operation::ALLOCATE;
+            op.requestId = ids[i];
+            op.slotId = results[i].slotId;
+            op.zoneId = results[i].zoneId;
+            op.slotIndex = city.findSlotIndex(results[i].slotId);
+            op.requestPos = positions[i];
+            rollbackManager.logOperation(op);
+            if (wal) wal->appendOperation(op);
+        }
+    }
+
+    if (logging) std::cout << "[System] Batch of " << batch.size() << " requests: " << allocated << " allocated ("
+              << crossZone << " cross-zone), " << (batch.size() - allocated) << " failed" << std::endl;
+    return ids;
 }
 
-bool ParkingSystem::cancelRequest(int requestId) {
-    for (auto& req : requests) {
-        if (req.getRequestId() == requestId) {
-            if (req.getState() == RequestState::ALLOCATED || req.getState() == RequestState::REQUESTED) {
-                 if (req.transitionTo(RequestState::CANCELLED)) {
-                    // Start rollback logic specific to single cancel?
-                    // "Cancelling a request must: Restore slot availability... Support rollback of last k operations"
-                    // If we cancel *now*, it's an operation itself. 
-                    // But if this is "undo", that's rollback.
-                    // Let's treat "cancelRequest" as a new user action.
-                    
-                    if (req.getAssignedSlotId() != -1) {
-                         // Find slot and release
-                         // We need zone ID. We didn't store assigned Zone ID in Request directly, 
-                         // but we can search or assuming we know it.
-                         // Actually Request doesn't store assigned Zone, only requested. 
-                         // To enable generic release, we might need to search or store AssignedZoneId in Request.
-                         // Let's brute force find for now or check current zones.
-                         // But we didn't store AssignedZone in Request class. 
-                         // Let's assume we can search all zones for the SlotID if IDs are unique, or change Request to store it.
-                         // For simplicity: Search global zones for slot ID.
-                         // Better: In real app, SlotID should be unique or Tuple. 
-                         // Our Slot class has ZoneID.
-                         
-                         // We need to look up which zone this slot belongs to.
-                         // Iterating all zones...
-                         bool found = false;
-                         for(auto& z : zones) {
-                             for(auto& a : z.getParkingAreasMutable()) {
-                                 for(auto& s : a.getSlotsMutable()) {
-                                     if(s.getSlotId() == req.getAssignedSlotId()) {
-                                         s.release();
-                                         found = true;
-                                         
-                                         Operation op;
-                                         op.type = Operation::CANCEL;
-                                         op.requestId = requestId;
-                                         op.slotId = s.getSlotId();
-                                         op.zoneId = z.getZoneId();
-                                         rollbackManager.logOperation(op);
-                                         break;
-                                     }
-                                 }
-                                 if(found) break;
-                             }
-                             if(found) break;
-                         }
-                    }
-                    std::cout << "[System] Request " << requestId << " Cancelled." << std::endl;
-                    return true;
-                 }
+bool ParkingSystem::applyCancel(int requestId) {
+    // Peek at the assigned slot first: its zone lock has to be taken before requestsLock
+    int slotIndex = -1;
+    {
+        auto lock = lockRequests();
+        ParkingRequest* req = findRequest(requestId);
+        if (!req) return false;
+        if (req->getAssignedSlotId() != -1) slotIndex = city.findSlotIndex(req->getAssignedSlotId());
+    }
+    ZoneGuard guard(city, slotIndex != -1 ? city.getSlotZone(slotIndex) : -1);
+    auto lock = lockRequests();
+    ParkingRequest* req = findRequest(requestId);
+
+    // Re-check under the locks: a concurrent rollback may have changed the assignment
+    int currentSlot = req->getAssignedSlotId() != -1 ? city.findSlotIndex(req->getAssignedSlotId()) : -1;
+    if (currentSlot != slotIndex) return false;
+
+    if (req->getState() == RequestState::ALLOCATED || req->getState() == RequestState::REQUESTED) {
+        if (req->transitionTo(RequestState::CANCELLED)) {
+            // Start rollback logic specific to single cancel?
+            // "Cancelling a request must: Restore slot availability... Support rollback of last k operations"
+            // If we cancel *now*, it's an operation itself. 
+            // But if this is "undo", that's rollback.
+            // Let's treat "cancelRequest" as a new user action.
+            
+            if (slotIndex != -1) {
+                // Slot IDs are unique city-wide, so the locator gave us the slot directly
+                city.releaseSlot(slotIndex);
+
+                Operation op;
+                op.type = Operation::CANCEL;
+                op.requestId = requestId;
+                op.slotId = req->getAssignedSlotId();
+                op.zoneId = req->getAssignedZoneId();
+                op.slotIndex = slotIndex;
+                op.requestPos = (int)(req - requests.data());
+                logOperation(op);
             }
+            requestChanged(*req, "cancel");
+            if (logging) std::cout << "[System] Request " << requestId << " Cancelled." << std::endl;
+            return true;
         }
     }
     return false;
 }
 
-bool ParkingSystem::leaveParking(int requestId) {
-    for (auto& req : requests) {
-        if (req.getRequestId() == requestId) {
-             long long duration = 0;
-             // If ALLOCATED, move to OCCUPIED first (Assuming vehicle arrived)
-             if (req.getState() == RequestState::ALLOCATED) {
-                 req.transitionTo(RequestState::OCCUPIED);
-             }
-
-             if (req.getState() == RequestState::OCCUPIED) {
-                 if (req.transitionTo(RequestState::RELEASED)) {
-                     // Release slot logic...
-                     if (req.getAssignedSlotId() != -1) {
-                         bool found = false;
-                         for(auto& z : zones) {
-                             for(auto& a : z.getParkingAreasMutable()) {
-                                 for(auto& s : a.getSlotsMutable()) {
-                                     if(s.getSlotId() == req.getAssignedSlotId()) {
-                                         s.release();
-                                         found = true;
-                                         break;
-                                     }
-                                 }
-                                 if(found) break;
-                             }
-                             if(found) break;
-                         }
-                     }
-                     req.setEndTime(std::time(nullptr));
-                     std::cout << "[System] Vehicle " << req.getVehicleId() << " left parking. Duration: " << req.getDuration() << "s" << std::endl;
-                     return true;
-                 }
-             }
+bool ParkingSystem::applyLeave(int requestId) {
+    int slotIndex = -1;
+    {
+        auto lock = lockRequests();
+        ParkingRequest* req = findRequest(requestId);
+        if (!req) return false;
+        if (req->getAssignedSlotId() != -1) slotIndex = city.findSlotIndex(req->getAssignedSlotId());
+    }
+    ZoneGuard guard(city, slotIndex != -1 ? city.getSlotZone(slotIndex) : -1);
+    auto lock = lockRequests();
+    ParkingRequest* req = findRequest(requestId);
+
+    int currentSlot = req->getAssignedSlotId() != -1 ? city.findSlotIndex(req->getAssignedSlotId()) : -1;
+    if (currentSlot != slotIndex) return false;
+
+    // If ALLOCATED, move to OCCUPIED first (Assuming vehicle arrived)
+    if (req->getState() == RequestState::ALLOCATED) {
+        req->transitionTo(RequestState::OCCUPIED);
+    }
+
+    if (req->getState() == RequestState::OCCUPIED) {
+        if (req->transitionTo(RequestState::RELEASED)) {
+            // Release slot logic...
+            if (slotIndex != -1) city.releaseSlot(slotIndex);
+            req->setEndTime(clock());
+            requestChanged(*req, "leave"); // Leave events are not in the rollback history, only in the WAL
+            if (logging) std::cout << "[System] Vehicle " << req->getVehicleId() << " left parking. Duration: " << req->getDuration() << "s" << std::endl;
+            return true;
         }
     }
     return false;
 }
 
-void ParkingSystem::rollbackOperations(int k) {
-    std::vector<Operation> ops = rollbackManager.rollback(k);
-    std::cout << "[Rollback] Rolling back " << ops.size() << " operations..." << std::endl;
-    
-    for (const auto& op : ops) {
-        if (op.type == Operation::ALLOCATE) {
-            // Undo Allocation -> Release Slot, set Request to REQUESTED
-            
-            // 1. Release slot
-            ParkingSlot* s = findSlotById(op.slotId, op.zoneId);
-            if (s) {
-                s->release();
-                std::cout << " -> Released Slot " << op.slotId << std::endl;
+void ParkingSystem::applyRollback(int k) {
+    // One rollback at a time, so undos are applied in exactly the reverse order they were logged
+    std::unique_lock<std::mutex> serial(rollbackLock.m, std::defer_lock);
+    if (concurrent) serial.lock();
+
+    {
+        // The view points into the history ring, which other threads keep writing to, so copy it out
+        // under the lock (undoBuffer keeps its capacity, so this stops allocating after the first rollbacks)
+        auto history = lockHistory();
+        RollbackView popped = rollbackManager.rollback(k);
+        undoBuffer.clear();
+        for (const Operation& op : popped) undoBuffer.push_back(op);
+    }
+
+    // Group by zone with a counting sort (O(k)), keeping the LIFO order inside each zone.
+    // All operations on one slot share a zone, so per-slot undo order is preserved.
+    int n = (int)undoBuffer.size();
+    undoZoneCount.resize(city.getZoneCount(), 0);
+    undoZones.clear();
+    for (const Operation& op : undoBuffer) {
+        int z = city.getSlotZone(op.slotIndex);
+        if (undoZoneCount[z]++ == 0) undoZones.push_back(z);
+    }
+    undoGroupStart.assign(1, 0);
+    for (int z : undoZones) {
+        int count = undoZoneCount[z];
+        undoZoneCount[z] = undoGroupStart.back(); // Now the write cursor of zone z's group
+        undoGroupStart.push_back(undoGroupStart.back() + count);
+    }
+    undoOrder.resize(n);
+    for (int i = 0; i < n; ++i) undoOrder[undoZoneCount[city.getSlotZone(undoBuffer[i].slotIndex)]++] = i;
+    for (int z : undoZones) undoZoneCount[z] = 0;
+
+    int released = 0;
+    int reoccupied = 0;
+    int reverted = 0;
+    int skipped = 0;
+    undoImages.clear();
+    collectingUndo = true;
+    for (size_t g = 0; g < undoZones.size(); ++g) {
+        // One lock acquisition per zone for all of its operations
+        ZoneGuard guard(city, undoZones[g]);
+        auto lock = lockRequests();
+
+        for (int i = undoGroupStart[g]; i < undoGroupStart[g + 1]; ++i) {
+            const Operation& op = undoBuffer[undoOrder[i]];
+            ParkingRequest* req = &requests[op.requestPos];
+            int s = op.slotIndex;
+
+            if (op.type == Operation::ALLOCATE) {
+                // Undo Allocation -> Release Slot, set Request to REQUESTED.
+                // The slot is only released if the request still holds it (it may belong to someone else by now).
+                bool holdsSlot = req->getAssignedSlotId() == op.slotId &&
+                                 (req->getState() == RequestState::ALLOCATED || req->getState() == RequestState::OCCUPIED);
+                if (holdsSlot && city.releaseSlot(s)) released++;
+                req->forceState(RequestState::REQUESTED);
+                req->assignSlot(-1, -1); // Clear slot assignment
+                requestChanged(*req, "rollback");
+                reverted++;
+            } else if (op.type == Operation::CANCEL) {
+                // Undo Cancel -> Re-occupy slot, set Request back to ALLOCATED
+                if (req->getState() != RequestState::CANCELLED || req->getAssignedSlotId() != op.slotId) {
+                    skipped++; // Already undone
+                } else if (!city.occupySlot(s)) {
+                    skipped++; // Another request got the slot after the cancel; reviving this one would double-book it
+                } else {
+                    req->forceState(RequestState::ALLOCATED);
+                    requestChanged(*req, "rollback");
+                    reoccupied++;
+                    reverted++;
+                }
             }
-            
-            // 2. Revert Request state
-            for (auto& req : requests) {
-                if (req.getRequestId() == op.requestId) {
-                    req.forceState(RequestState::REQUESTED);
-                    req.assignSlot(-1); // Clear slot assignment
-                    std::cout << " -> Reverted Request " << op.requestId << " to REQUESTED" << std::endl;
+        }
+    }
+
+    collectingUndo = false;
+    if (wal) wal->appendRollback(n, undoImages);
+
+    if (logging) {
+        std::cout << "[Rollback] Rolled back " << n << " operations across " << undoZones.size() << " zones: "
+                  << released << " slots released, " << reoccupied << " re-occupied, " << reverted << " requests reverted";
+        if (skipped > 0) std::cout << ", " << skipped << " skipped";
+        std::cout << std::endl;
+    }
+}
+
+void ParkingSystem::setRollbackDepth(size_t depth) {
+    // Resizing invalidates handles a rollback in flight is reading, so follow the rollback lock order
+    auto gate = enterCommit();
+    std::unique_lock<std::mutex> serial(rollbackLock.m, std::defer_lock);
+    if (concurrent) serial.lock();
+    auto history = lockHistory();
+    rollbackManager.setDepth(depth);
+}
+
+unsigned long ParkingSystem::getRollbackDropped() {
+    auto history = lockHistory();
+    return rollbackManager.getDroppedCount();
+}
+
+void ParkingSystem::setRetention(const RetentionPolicy& policy) {
+    retention = policy;
+}
+
+void ParkingSystem::setClock(time_t (*now)()) {
+    clock = now;
+}
+
+const ColdArchive& ParkingSystem::getArchive() const {
+    return archive;
+}
+
+size_t ParkingSystem::archiveRequests() {
+    if (retention.hotSeconds < 0 && retention.archiveSeconds < 0) return 0;
+    size_t archived = 0;
+    size_t dropped = 0;
+    size_t hot;
+    {
+        // Request positions move, so all mutations, snapshot cuts, checkpoints and queries wait (O(requests))
+        std::unique_lock<std::shared_mutex> gate(commitGate.m, std::defer_lock);
+        if (concurrent) gate.lock();
+        auto lock = lockRequests();
+        auto history = lockHistory();
+        time_t now = clock();
+
+        std::vector<int> newPos(requests.size(), -1);
+        if (retention.hotSeconds >= 0) {
+            // Anything the rollback history can still bring back stays hot
+            std::vector<char> pinned(requests.size(), 0);
+            for (const Operation& op : rollbackManager.peek((int)rollbackManager.size())) pinned[op.requestPos] = 1;
+            time_t cutoff = now - retention.hotSeconds;
+            for (size_t pos = 0; pos < requests.size(); ++pos) {
+                const ParkingRequest& req = requests[pos];
+                // Cancellations have no end time; they count from the request
+                time_t finished = req.getEndTime() != 0 ? req.getEndTime() : req.getRequestTime();
+                bool done = req.getState() == RequestState::RELEASED || req.getState() == RequestState::CANCELLED;
+                if (done && !pinned[pos] && finished <= cutoff) {
+                    archive.append(req, finished);
+                    archived++;
+                } else {
+                    newPos[pos] = 0; // Kept; numbered below
                 }
             }
-        } else if (op.type == Operation::CANCEL) {
-            // Undo Cancel -> Re-occupy slot, set Request back to ALLOCATED
-            ParkingSlot* s = findSlotById(op.slotId, op.zoneId);
-            if (s) {
-                s->occupy();
-                std::cout << " -> Re-occupied Slot " << op.slotId << std::endl;
+        }
+        if (archived > 0) {
+            // Survivors keep their order. Archived IDs (and earlier tombstones) get a tombstone with their
+            // insertion point, so query cursors naming them resume in the right place.
+            std::vector<int> keptBefore(requests.size() + 1, 0);
+            for (size_t pos = 0; pos < requests.size(); ++pos) keptBefore[pos + 1] = keptBefore[pos] + (newPos[pos] != -1);
+            size_t firstNeeded = requestPosById.size(); // Entries before it are gaps or tombstones at 0: dropped
+            for (size_t offset = 0; offset < requestPosById.size(); ++offset) {
+                int v = requestPosById[offset];
+                if (v == -1) continue;
+                bool kept = v >= 0 && newPos[v] != -1;
+                int insertAt = keptBefore[v >= 0 ? v : -2 - v];
+                requestPosById[offset] = kept ? insertAt : -2 - insertAt;
+                if ((kept || insertAt > 0) && firstNeeded == requestPosById.size()) firstNeeded = offset;
             }
-            
-            for (auto& req : requests) {
-                 if (req.getRequestId() == op.requestId) {
-                     req.forceState(RequestState::ALLOCATED);
-                     std::cout << " -> Reverted Request " << op.requestId << " to ALLOCATED" << std::endl;
-                 }
+            requestPosById.erase(requestPosById.begin(), requestPosById.begin() + firstNeeded);
+            requestPosById.shrink_to_fit();
+            firstRequestId += (int)firstNeeded;
+
+            // Rebuild the table and indexes from the survivors, in their original order
+            std::vector<ParkingRequest> old;
+            old.swap(requests);
+            requests.reserve(old.size() - archived);
+            requestIndex = RequestIndex();
+            requestIndex.reserve(old.size() - archived);
+            for (size_t pos = 0; pos < old.size(); ++pos) {
+                if (newPos[pos] == -1) continue;
+                newPos[pos] = (int)requests.size();
+                requests.push_back(std::move(old[pos]));
+                requestIndex.add(newPos[pos], requests.back());
             }
+            rollbackManager.remapRequests(newPos);
+            dirtyRequests.clear();
+            requestDirty.assign(requests.size(), 0);
+            requestsCompacted = true;
         }
+        if (retention.archiveSeconds >= 0) dropped = archive.dropFinishedBefore(now - retention.archiveSeconds);
+        hot = requests.size();
     }
+    if (archived > 0) committed(); // Readers get the smaller table
+    if (logging && (archived > 0 || dropped > 0)) {
+        std::cout << "[System] Archived " << archived << " finished requests, dropped " << dropped << " past retention ("
+                  << hot << " hot, " << archive.getRecordCount() << " archived in " << archive.getByteCount() / 1024 << " KB)" << std::endl;
+    }
+    return archived;
 }
 
 void ParkingSystem::printAnalytics() const {
@@ -205,39 +1026,40 @@ void ParkingSystem::printAnalytics() const {
     int maxUsage = -1;
     int peakZoneId = -1;
 
-    for (const auto& z : zones) {
-        int capacity = 0;
-        int occupied = 0;
-        for (const auto& a : z.getParkingAreas()) {
-             capacity += a.getSlots().size();
-             for (const auto& s : a.getSlots()) {
-                 if(s.isOccupied()) occupied++;
-             }
-        }
+    for (int z = 0; z < city.getZoneCount(); ++z) {
+        int zoneId = city.getZoneId(z);
+        int capacity = city.getZoneCapacity(z);
+        int occupied = city.getZoneOccupied(z);
         double rate = capacity > 0 ? (double)occupied / capacity * 100.0 : 0.0;
-        std::cout << "  Zone " << z.getZoneId() << ": " << std::fixed << std::setprecision(1) << rate << "% (" << occupied << "/" << capacity << ")\n";
+        std::cout << "  Zone " << zoneId << ": " << std::fixed << std::setprecision(1) << rate << "% (" << occupied << "/" << capacity << ")\n";
         
         if (occupied > maxUsage) {
             maxUsage = occupied;
-            peakZoneId = z.getZoneId();
+            peakZoneId = zoneId;
         }
     }
 
-    for(const auto& r : requests) {
+    auto count = [&](const ParkingRequest& r) {
         if(r.getState() == RequestState::CANCELLED) cancelled++;
         else if (r.getState() == RequestState::RELEASED) {
             completed++;
             totalDuration += r.getDuration();
         }
-    }
+    };
+    for(const auto& r : requests) count(r);
+    archive.scan(count); // Finished requests moved to cold storage
+    total += (int)archive.getRecordCount();
     
     double avgDuration = completed > 0 ? totalDuration / completed : 0.0;
 
     std::cout << "\nGeneral Stats:\n";
-    std::cout << "Total Requests: " << total << "\n";
+    std::cout << "Total Requests: " << total << " (" << archive.getRecordCount() << " archived, "
+              << archive.getDroppedCount() << " more dropped by retention)\n";
     std::cout << "Cancelled: " << cancelled << "\n";
     std::cout << "Completed (Left): " << completed << "\n";
     std::cout << "Average Duration: " << avgDuration << " seconds\n";
     std::cout << "Peak Usage Zone: Zone " << peakZoneId << "\n";
+    std::cout << "Rollback History: " << rollbackManager.size() << "/" << rollbackManager.getDepth()
+              << " kept, " << rollbackManager.getDroppedCount() << " dropped\n";
     std::cout << "-----------------\n";
 }
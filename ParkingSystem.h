@@ -3,35 +3,203 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
+#include <memory>
+#include <shared_mutex>
+#include "Concurrency.h"
+#include "StateSnapshot.h"
+#include "CityLayout.h"
 #include "Zone.h"
 #include "ParkingRequest.h"
 #include "AllocationEngine.h"
 #include "RollbackManager.h"
+#include "WriteAheadLog.h"
+#include "CityImage.h"
+#include "ChangeLog.h"
+#include "EventHub.h"
+#include "RequestIndex.h"
+#include "ColdArchive.h"
+
+// One entry of a batch arrival (see requestParkingBatch)
+struct ParkingRequestSpec {
+    std::string vehicleId;
+    int zoneId;
+};
+
+// Outcome of ParkingSystem::forkBackup
+struct BackupStats {
+    double pauseMs;    // Writers held back: the fork itself (page-table copy)
+    double totalMs;    // Until the child had written and synced the image
+    long imageBytes;
+    long duplicatedKB; // Pages the parent copied-on-write (or newly allocated) while the child ran
+    bool busy;         // Refused: another backup was still running
+};
+
+// When finished requests leave the request table (see ParkingSystem::archiveRequests). -1 disables a step.
+struct RetentionPolicy {
+    long hotSeconds = -1;     // RELEASED/CANCELLED requests move to the cold archive this long after they finish
+    long archiveSeconds = -1; // and are dropped from the archive this long after they finish
+};
 
 class ParkingSystem {
 private:
-    std::vector<Zone> zones;
-    std::vector<ParkingRequest> requests;
+    CityLayout city; // Flattened zones/areas/slots, with zone-id and slot-id lookup tables
+    std::vector<ParkingRequest> requests; // Hot table: live requests and recently finished ones
+    int firstRequestId; // ID at requestPosById[0]
+    // (requestId - firstRequestId) -> index into requests, -1 if absent. An archived request keeps a
+    // tombstone -2 - p, p being where it would sit now (the hot requests before it), for query cursors.
+    std::vector<int> requestPosById;
+    RequestIndex requestIndex; // By state, zone and vehicle, for queryRequests (under requestsLock)
     RollbackManager rollbackManager;
 
-    ParkingSlot* findSlotById(int slotId, int zoneId);
+    // Concurrent mode (enableConcurrency). Lock order: commitGate (shared) -> rollbackLock -> zone locks
+    // (ascending, via ZoneGuard) -> requestsLock -> historyLock. Each is held only for a few O(1) steps.
+    bool concurrent;
+    CopyableSharedMutex commitGate; // Shared by every mutation, exclusive while a snapshot is cut or a rollback runs
+    CopyableMutex rollbackLock; // Serializes rollbacks
+    std::vector<Operation> undoBuffer; // Operations being undone (under rollbackLock)
+    bool collectingUndo; // requestChanged collects images into undoImages instead of logging them
+    std::vector<ParkingRequest> undoImages;
+    // Scratch for grouping undoBuffer by zone; kept as members so rollbacks stop allocating
+    std::vector<int> undoZones;      // Distinct zones, in order of first appearance
+    std::vector<int> undoGroupStart; // Group g is undoOrder[undoGroupStart[g], undoGroupStart[g+1])
+    std::vector<int> undoOrder;      // undoBuffer indices grouped by zone
+    std::vector<int> undoZoneCount;  // Per zone index, all zero between rollbacks
+    CopyableMutex requestsLock; // requests, requestPosById, request states
+    CopyableMutex historyLock;  // rollbackManager
+    bool logging;
+
+    // Published snapshots (see publishSnapshot)
+    std::shared_ptr<const StateSnapshot> snapshot; // Swapped with std::atomic_store
+    std::shared_ptr<const SnapshotLayout> snapshotLayout;
+    unsigned long snapshotVersion;
+    CopyableAtomic<unsigned long> mutationCount;
+    bool snapshotOnCommit;
+    CopyableMutex publishLock;
+    // Delta sync: what each snapshot version changed. Requests changed since the last publish are
+    // collected here (under requestsLock); changed slots are found by diffing consecutive snapshots.
+    ChangeLog changeLog;
+    std::vector<int> dirtyRequests;
+    std::vector<char> requestDirty; // Per request position, set while listed in dirtyRequests
+    std::shared_ptr<EventHub> events; // Null unless setEventHub
+    bool requestsCompacted; // Positions moved since the last publish (archiveRequests): delta clients resync
+
+    // Cold storage of finished requests (under requestsLock)
+    ColdArchive archive;
+    RetentionPolicy retention;
+    time_t (*clock)(); // Creation, leave and retention times
+
+    std::shared_ptr<WriteAheadLog> wal; // Null unless openWriteAheadLog succeeded
+
+    // Checkpoints (see writeCheckpoint). The log is split into numbered segments: segment g holds
+    // what was logged after checkpoint g, and an image of generation g makes every older segment obsolete.
+    std::string walPath;
+    unsigned long logGeneration;        // Segment being appended to
+    unsigned long checkpointGeneration; // Last image written or loaded, 0 if none
+    std::vector<std::string> oldSegments; // Rotated away, deleted once an image covers them
+    CopyableMutex checkpointLock;
+    CopyableMutex backupLock; // One forkBackup (and forked child) at a time
+
+    std::shared_lock<std::shared_mutex> enterCommit();
+    void committed(); // Counts the mutation and publishes if snapshotOnCommit
+    std::unique_lock<std::mutex> lockRequests();
+    std::unique_lock<std::mutex> lockHistory();
+    void logOperation(const Operation& op);
+    // WAL image, index update, delta-sync mark and pushed event after a change (caller holds requestsLock)
+    void requestChanged(const ParkingRequest& req, const char* eventType);
+    // Replays one segment; false if it predates the loaded image. `touched` marks request positions
+    // whose slot must be re-occupied afterwards.
+    bool replayLog(WalReader& reader, std::vector<char>& touched);
+    void replayImage(const WalRecord& rec, std::vector<char>& touched);
+    std::string segmentPath(unsigned long generation) const;
+    void encodeImage(CityImageWriter& image, CityImageHeader& header); // Caller holds writers back
+
+    // Mutation bodies; the public wrappers hold the commit gate around them
+    int applyRequest(const std::string& vehicleId, int preferredZoneId);
+    std::vector<int> applyBatch(const std::vector<ParkingRequestSpec>& batch);
+    bool applyCancel(int requestId);
+    bool applyLeave(int requestId);
+    void applyRollback(int k);
+
+    int storeRequest(ParkingRequest req); // Returns its position in requests
+    ParkingRequest* findRequest(int requestId); // O(1) via requestPosById, nullptr if unknown
 
 public:
     ParkingSystem();
 
-    void addZone(const Zone& zone);
+    // City assembly, append-only: areas go to the zone added last, slots to the area added last
+    Zone addZone(int zoneId);
+
+    // Make the core capabilities safe to call from many threads (e.g. httplib's pool).
+    // Each zone gets its own lock, so allocations in different zones run in parallel.
+    // Call once, after the city is assembled.
+    void enableConcurrency();
+    // Concurrency plus lock-free slot claiming: allocateSlot takes no mutex, so many threads
+    // can allocate in the same busy zone at once (see CityLayout::claimFreeSlot)
+    void enableLockFreeClaiming();
+    void setLogging(bool enabled); // Per-operation std::cout lines (on by default)
+
+    // Durability: replays `path` (if it exists) into this freshly assembled city, then appends every
+    // change to it. fsyncs are grouped: every groupMs, or once groupRecords are pending.
+    // Call after assembly and before any requests or concurrent use.
+    bool openWriteAheadLog(const std::string& path, int groupRecords = 256, int groupMs = 5);
+    bool syncWriteAheadLog(); // Blocks until everything so far is on disk; false if the log failed to write it
+
+    // Startup without replaying history: writeCheckpoint saves the city, occupancy, requests and rollback
+    // history as one mappable image and drops the log segments it covers; loadCheckpoint restores it into
+    // an empty system (before addZone), after which openWriteAheadLog replays only the log tail.
+    bool writeCheckpoint(const std::string& imagePath);
+    bool loadCheckpoint(const std::string& imagePath); // False if missing or corrupt: assemble the city instead
+
+    // Point-in-time backup without stopping the world: forks between two operations and lets the child
+    // write the copy-on-write view as a checkpoint image while this process keeps serving. Blocks only the
+    // calling thread until the image is on disk. Restore it with loadCheckpoint alone (it is not tied to the log).
+    // One backup runs at a time; a call while one is running returns false at once with stats.busy set.
+    bool forkBackup(const std::string& imagePath, BackupStats& stats);
     
     // Core capabilities
     int requestParking(std::string vehicleId, int preferredZoneId); // Returns requestId
+    // Burst arrivals: grouped by zone, one allocation pass per zone, one summary line.
+    // Returns the request IDs in input order.
+    std::vector<int> requestParkingBatch(const std::vector<ParkingRequestSpec>& batch);
     bool leaveParking(int requestId); // New: Complete the lifecycle
     bool cancelRequest(int requestId);
     void rollbackOperations(int k);
+    // Undo history keeps the newest `depth` operations (RollbackManager::DEFAULT_DEPTH by default)
+    void setRollbackDepth(size_t depth);
+    unsigned long getRollbackDropped(); // Operations evicted from the history so far
     
     // Getters for API/GUI
-    const std::vector<Zone>& getZones() const;
-    const std::vector<ParkingRequest>& getRequests() const;
+    ViewRange<Zone> getZones();
+    const std::vector<ParkingRequest>& getRequests() const; // Single-threaded use; concurrent readers use getSnapshot()
+    // One page of the requests matching `query`, oldest first, from secondary indexes (cost follows the
+    // page, not the history). nextCursor is the afterRequestId for the next page, -1 after the last one.
+    // A cursor naming a request archived since resumes where it was. False if the cursor names an unknown request.
+    bool queryRequests(const RequestQuery& query, std::vector<ParkingRequest>& page, int& nextCursor);
+
+    // Readers (dashboard, analytics) take an immutable snapshot in O(1) and never block writers.
+    // Snapshots are cut between mutations, so zones, slots and requests always agree.
+    std::shared_ptr<const StateSnapshot> getSnapshot(); // Publishes the first one on demand
+    void publishSnapshot();
+    void setSnapshotOnCommit(bool enabled); // Publish after every mutation (else see SnapshotPublisher)
+    unsigned long getMutationCount() const;
+    // Delta sync: slot indices and request positions whose values in `snap` differ from snapshot version
+    // `since`. False if the client is too far behind (or the city's structure changed): send everything.
+    bool getChangesSince(unsigned long since, const StateSnapshot& snap, std::vector<int>& slots, std::vector<int>& requests);
+    // Push every request change (allocate, cancel, leave, rollback) to the hub's subscribers as it happens.
+    // Set before concurrent use.
+    void setEventHub(std::shared_ptr<EventHub> hub);
     
-    // Analytics
+    // Hot/cold storage: moves finished requests past retention.hotSeconds into the compressed cold archive
+    // and compacts the request table, keeping any the rollback history can still undo. Drops archived ones
+    // past retention.archiveSeconds. Holds every writer back for O(requests); run it periodically
+    // (Checkpointer does, before each checkpoint). Returns the number archived.
+    void setRetention(const RetentionPolicy& policy);
+    size_t archiveRequests();
+    const ColdArchive& getArchive() const; // Single-threaded use, like getRequests()
+    void setClock(time_t (*now)()); // Replaces std::time (simulations)
+
+    // Analytics (hot table and cold archive)
     void printAnalytics() const;
     void printSystemStatus() const;
 };
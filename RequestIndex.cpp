@@ -0,0 +1,205 @@
+#include "RequestIndex.h"
+#include <algorithm>
+#include <functional>
+
+void RequestIndex::enter(PositionList& list, int pos) {
+    std::vector<int>& p = list.positions;
+    if (p.empty() || p.back() < pos) {
+        p.push_back(pos); // The usual case: a new request, or the newest one changing
+        return;
+    }
+    auto it = std::lower_bound(p.begin(), p.end(), pos);
+    if (it != p.end() && *it == pos) {
+        list.stale--; // Coming back before its stale entry was compacted away
+    } else {
+        p.insert(it, pos); // An older request coming back (rollback)
+    }
+}
+
+template <typename Live>
+void RequestIndex::leave(PositionList& list, Live live) {
+    if (++list.stale * 2 <= list.positions.size()) return;
+    list.positions.erase(std::remove_if(list.positions.begin(), list.positions.end(), [&](int p) { return !live(p); }),
+                         list.positions.end());
+    list.stale = 0;
+}
+
+size_t RequestIndex::findVehicle(std::uint64_t hash) const {
+    size_t mask = vehicleTable.size() - 1;
+    size_t i = (size_t)hash & mask;
+    while (vehicleTable[i].newest != -1 && vehicleTable[i].hash != hash) i = (i + 1) & mask;
+    return i;
+}
+
+bool RequestIndex::matches(const RequestQuery& q, const ParkingRequest& req) {
+    if (!q.states.empty() && std::find(q.states.begin(), q.states.end(), req.getState()) == q.states.end()) return false;
+    if (q.requestedZoneId != -1 && req.getRequestedZoneId() != q.requestedZoneId) return false;
+    if (q.assignedZoneId != -1 && req.getAssignedZoneId() != q.assignedZoneId) return false;
+    if (q.from != 0 && req.getRequestTime() < q.from) return false;
+    if (q.to != 0 && req.getRequestTime() > q.to) return false;
+    return q.vehicleId.empty() || req.getVehicleId() == q.vehicleId;
+}
+
+void RequestIndex::reserve(size_t requests) {
+    indexed.reserve(requests);
+    latestCreated.reserve(requests);
+    previousSameVehicle.reserve(requests);
+    size_t size = 64;
+    while (size < requests * 2) size *= 2;
+    if (size <= vehicleTable.size()) return;
+    std::vector<VehicleSlot> old(size, VehicleSlot{0, -1, 0});
+    old.swap(vehicleTable);
+    for (const VehicleSlot& v : old) {
+        if (v.newest != -1) vehicleTable[findVehicle(v.hash)] = v;
+    }
+}
+
+void RequestIndex::add(int pos, const ParkingRequest& req) {
+    if ((size_t)pos >= indexed.size()) indexed.resize(pos + 1);
+    indexed[pos] = Indexed{req.getState(), req.getAssignedZoneId()};
+    if ((size_t)pos >= latestCreated.size()) latestCreated.resize(pos + 1, 0);
+    time_t created = req.getRequestTime();
+    latestCreated[pos] = pos > 0 && latestCreated[pos - 1] > created ? latestCreated[pos - 1] : created;
+    if (created < latestCreated[pos]) outOfOrder.push_back(pos);
+    enter(byState[(int)req.getState()], pos);
+    if (req.getAssignedZoneId() != -1) enter(byAssignedZone[req.getAssignedZoneId()], pos);
+    enter(byRequestedZone[req.getRequestedZoneId()], pos);
+
+    if ((vehicleCount + 1) * 2 > vehicleTable.size()) reserve(std::max<size_t>(vehicleTable.size(), 32));
+    std::uint64_t hash = std::hash<std::string>()(req.getVehicleId());
+    VehicleSlot& v = vehicleTable[findVehicle(hash)];
+    if (v.newest == -1) {
+        v = VehicleSlot{hash, -1, 0};
+        vehicleCount++;
+    }
+    if ((size_t)pos >= previousSameVehicle.size()) previousSameVehicle.resize(pos + 1, -1);
+    previousSameVehicle[pos] = v.newest;
+    v.newest = pos;
+    v.count++;
+}
+
+void RequestIndex::update(int pos, const ParkingRequest& req) {
+    Indexed& ix = indexed[pos];
+    if (ix.state != req.getState()) {
+        RequestState old = ix.state;
+        ix.state = req.getState();
+        leave(byState[(int)old], [&](int p) { return indexed[p].state == old; });
+        enter(byState[(int)ix.state], pos);
+    }
+    if (ix.assignedZoneId != req.getAssignedZoneId()) {
+        int old = ix.assignedZoneId;
+        ix.assignedZoneId = req.getAssignedZoneId();
+        if (old != -1) leave(byAssignedZone[old], [&](int p) { return indexed[p].assignedZoneId == old; });
+        if (ix.assignedZoneId != -1) enter(byAssignedZone[ix.assignedZoneId], pos);
+    }
+}
+
+void RequestIndex::query(const RequestQuery& q, int afterPos, const std::vector<ParkingRequest>& requests,
+                         std::vector<int>& out) const {
+    out.clear();
+    if (q.limit <= 0) return;
+
+    // The time range is a range of positions, searched on the running max of creation times: everything
+    // before `begin` was created before q.from. Past `end` only out-of-order positions can still match.
+    auto firstAfter = [&](size_t lo, time_t t, bool inclusive) {
+        size_t hi = requests.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            time_t created = latestCreated[mid];
+            if (created < t || (!inclusive && created == t)) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    };
+    size_t begin = (size_t)(afterPos + 1);
+    size_t end = requests.size();
+    if (q.from != 0) begin = firstAfter(begin, q.from, true);
+    if (q.to != 0) end = firstAfter(begin, q.to, false);
+    size_t outOfOrderFrom = std::max(begin, end);
+    if (begin > end) end = begin;
+
+    // Drive the scan with the smallest applicable index
+    const PositionList* best = nullptr;
+    size_t bestSize = end - begin;
+    auto consider = [&](const PositionList* list) {
+        if (list->positions.size() - list->stale < bestSize) {
+            best = list;
+            bestSize = list->positions.size() - list->stale;
+        }
+    };
+    if (q.requestedZoneId != -1) {
+        auto it = byRequestedZone.find(q.requestedZoneId);
+        if (it == byRequestedZone.end()) return;
+        consider(&it->second);
+    }
+    if (q.assignedZoneId != -1) {
+        auto it = byAssignedZone.find(q.assignedZoneId);
+        if (it == byAssignedZone.end()) return;
+        consider(&it->second);
+    }
+    // The vehicle's chain runs newest first; take the part after the cursor, ascending
+    std::vector<int> vehiclePositions;
+    const VehicleSlot* vehicle = nullptr;
+    if (!q.vehicleId.empty()) {
+        if (vehicleTable.empty()) return;
+        vehicle = &vehicleTable[findVehicle(std::hash<std::string>()(q.vehicleId))];
+        if (vehicle->newest == -1) return;
+        if ((size_t)vehicle->count < bestSize) {
+            for (int pos = vehicle->newest; pos != -1 && (size_t)pos >= begin; pos = previousSameVehicle[pos]) {
+                if ((size_t)pos < end) vehiclePositions.push_back(pos);
+            }
+            std::reverse(vehiclePositions.begin(), vehiclePositions.end());
+            best = nullptr;
+            bestSize = vehiclePositions.size();
+        } else {
+            vehicle = nullptr;
+        }
+    }
+    size_t stateSize = 0;
+    for (RequestState s : q.states) stateSize += byState[(int)s].positions.size() - byState[(int)s].stale;
+    bool byStates = !q.states.empty() && stateSize < bestSize;
+
+    auto visit = [&](int pos) {
+        if (matches(q, requests[pos])) out.push_back(pos);
+        return (int)out.size() < q.limit;
+    };
+    if (byStates) {
+        // Merge the state lists; a stale entry can repeat a position listed live in another one
+        std::vector<std::pair<const std::vector<int>*, size_t>> cursors;
+        for (RequestState s : q.states) {
+            const std::vector<int>& p = byState[(int)s].positions;
+            cursors.push_back({&p, (size_t)(std::lower_bound(p.begin(), p.end(), (int)begin) - p.begin())});
+        }
+        int last = -1;
+        while (true) {
+            int next = -1;
+            size_t from = 0;
+            for (size_t k = 0; k < cursors.size(); ++k) {
+                if (cursors[k].second < cursors[k].first->size() &&
+                    (next == -1 || (*cursors[k].first)[cursors[k].second] < next)) {
+                    next = (*cursors[k].first)[cursors[k].second];
+                    from = k;
+                }
+            }
+            if (next == -1 || (size_t)next >= end) break;
+            cursors[from].second++;
+            if (next != last && !visit(next)) return;
+            last = next;
+        }
+    } else if (vehicle) {
+        for (int pos : vehiclePositions) {
+            if (!visit(pos)) return;
+        }
+    } else if (best) {
+        const std::vector<int>& p = best->positions;
+        for (auto it = std::lower_bound(p.begin(), p.end(), (int)begin); it != p.end() && (size_t)*it < end; ++it) {
+            if (!visit(*it)) return;
+        }
+    } else {
+        for (size_t pos = begin; pos < end; ++pos) {
+            if (!visit((int)pos)) return;
+        }
+    }
+    for (auto it = std::lower_bound(outOfOrder.begin(), outOfOrder.end(), (int)outOfOrderFrom); it != outOfOrder.end(); ++it) {
+        if (!visit(*it)) return;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef REQUEST_INDEX_H
+#define REQUEST_INDEX_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ParkingRequest.h"
+
+// Filters for ParkingSystem::queryRequests; unset fields match every request
+struct RequestQuery {
+    std::vector<RequestState> states; // Any of these; empty for all
+    int requestedZoneId = -1;
+    int assignedZoneId = -1;
+    std::string vehicleId;            // Exact match; empty for all
+    time_t from = 0;                  // Created at or after; 0 for no bound
+    time_t to = 0;                    // Created at or before; 0 for no bound
+    int afterRequestId = -1;          // Cursor: the last request of the previous page
+    int limit = 100;
+};
+
+// Secondary indexes over ParkingSystem's request table (by position): per state, per requested
+// and assigned zone, and per vehicle. A query walks the smallest index that applies, in position
+// (creation) order, and checks the other filters per entry, so it costs about the size of that index
+// from the cursor onwards rather than the whole history. Creation times mostly rise with position;
+// the few stored out of order (concurrent stores) are tracked so time ranges still find them.
+class RequestIndex {
+private:
+    static const int STATE_COUNT = 5;
+
+    // Ascending positions. When a request moves to another state or zone its entry here is left
+    // stale (readers re-check the request) and removed when half the list is stale.
+    struct PositionList {
+        std::vector<int> positions;
+        size_t stale = 0;
+    };
+
+    struct Indexed { // What the state and assigned-zone lists currently hold for a position
+        RequestState state;
+        int assignedZoneId;
+    };
+
+    std::vector<Indexed> indexed;
+    std::vector<time_t> latestCreated; // Max creation time over positions [0, pos]: non-decreasing, so binary-searchable
+    std::vector<int> outOfOrder;       // Positions created before some earlier position, ascending
+    PositionList byState[STATE_COUNT];
+    std::unordered_map<int, PositionList> byRequestedZone; // Never stale: the requested zone is fixed
+    std::unordered_map<int, PositionList> byAssignedZone;
+
+    // Vehicles are mostly distinct, so instead of a list each they get one slot in a flat open-addressing
+    // table (newest position per vehicle ID hash) and every position links to the previous one of its hash
+    struct VehicleSlot {
+        std::uint64_t hash;
+        int newest; // -1 if the slot is empty
+        int count;
+    };
+    std::vector<VehicleSlot> vehicleTable; // Power-of-two size, at most half full
+    size_t vehicleCount = 0;
+    std::vector<int> previousSameVehicle;
+
+    size_t findVehicle(std::uint64_t hash) const; // Its slot, or the empty slot where it would go
+    static void enter(PositionList& list, int pos);
+    template <typename Live>
+    static void leave(PositionList& list, Live live);
+    static bool matches(const RequestQuery& q, const ParkingRequest& req);
+
+public:
+    void reserve(size_t requests); // Before adding many at once
+    void add(int pos, const ParkingRequest& req);    // A new position, one past the last
+    void update(int pos, const ParkingRequest& req); // After a change of state or assigned slot
+
+    // Positions after `afterPos` matching `q`, ascending, at most q.limit of them
+    void query(const RequestQuery& q, int afterPos, const std::vector<ParkingRequest>& requests,
+               std::vector<int>& out) const;
+};
+
+#endif // REQUEST_INDEX_H
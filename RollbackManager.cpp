@@ -1,15 +1,66 @@
 #include "RollbackManager.h"
 
-void RollbackManager::logOperation(Operation op) {
-    history.push(op);
+RollbackManager::RollbackManager(size_t depth) : ring(depth > 0 ? depth : 1), next(0), count(0), dropped(0) {}
+
+void RollbackManager::logOperation(const Operation& op) {
+    ring[next] = op;
+    next = (next + 1) % ring.size();
+    if (count < ring.size()) {
+        count++;
+    } else {
+        dropped++; // Overwrote the oldest entry
+    }
+}
+
+RollbackView RollbackManager::rollback(int k) {
+    size_t n = k > 0 ? (size_t)k : 0;
+    if (n > count) n = count;
+    size_t newest = (next + ring.size() - 1) % ring.size();
+    // Popped entries stay in the ring until overwritten, which is what the view reads
+    next = (next + ring.size() - n) % ring.size();
+    count -= n;
+    return RollbackView(ring.data(), ring.size(), newest, n);
+}
+
+RollbackView RollbackManager::peek(int k) const {
+    size_t n = k > 0 ? (size_t)k : 0;
+    if (n > count) n = count;
+    return RollbackView(ring.data(), ring.size(), (next + ring.size() - 1) % ring.size(), n);
+}
+
+void RollbackManager::setDepth(size_t depth) {
+    if (depth == 0) depth = 1;
+    size_t keep = count < depth ? count : depth;
+    std::vector<Operation> resized(depth);
+    // Oldest kept operation first, so the newest ends up just before `next`
+    for (size_t i = 0; i < keep; ++i) {
+        resized[i] = ring[(next + ring.size() - keep + i) % ring.size()];
+    }
+    dropped += count - keep;
+    ring.swap(resized);
+    count = keep;
+    next = keep % depth;
+}
+
+size_t RollbackManager::getDepth() const {
+    return ring.size();
+}
+
+size_t RollbackManager::size() const {
+    return count;
+}
+
+unsigned long RollbackManager::getDroppedCount() const {
+    return dropped;
+}
+
+void RollbackManager::setDroppedCount(unsigned long n) {
+    dropped = n;
 }
 
-std::vector<Operation> RollbackManager::rollback(int k) {
-    std::vector<Operation> opsToUndo;
-    while (k > 0 && !history.empty()) {
-        opsToUndo.push_back(history.top());
-        history.pop();
-        k--;
+void RollbackManager::remapRequests(const std::vector<int>& newPos) {
+    for (size_t i = 0; i < count; ++i) {
+        Operation& op = ring[(next + ring.size() - 1 - i) % ring.size()];
+        op.requestPos = newPos[op.requestPos];
     }
-    return opsToUndo;
 }
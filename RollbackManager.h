@@ -1,8 +1,8 @@
 #ifndef ROLLBACK_MANAGER_H
 #define ROLLBACK_MANAGER_H
 
-#include <stack>
 #include <vector>
+#include <cstddef>
 #include "ParkingRequest.h"
 #include "ParkingSlot.h"
 
@@ -13,19 +13,68 @@ struct Operation {
     int requestId;
     int slotId;
     int zoneId;
+    // Direct handles so rollback never looks anything up: global slot index in the CityLayout
+    // and position in ParkingSystem's request table
+    int slotIndex;
+    int requestPos;
 };
 
+// Operations popped by RollbackManager::rollback, newest first.
+// Points into the manager's ring, so it is only valid until the next logOperation/setDepth.
+class RollbackView {
+private:
+    const Operation* ring;
+    size_t capacity;
+    size_t newest; // Ring position of element 0
+    size_t count;
+
+public:
+    class iterator {
+    private:
+        const RollbackView* view;
+        size_t i;
+    public:
+        iterator(const RollbackView* v, size_t index) : view(v), i(index) {}
+        const Operation& operator*() const { return (*view)[i]; }
+        iterator& operator++() { ++i; return *this; }
+        bool operator!=(const iterator& other) const { return i != other.i; }
+    };
+
+    RollbackView(const Operation* r, size_t cap, size_t newestPos, size_t n) : ring(r), capacity(cap), newest(newestPos), count(n) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Operation& operator[](size_t i) const { return ring[(newest + capacity - i) % capacity]; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, count); }
+};
+
+// Fixed-depth undo history: a preallocated ring that keeps the newest `depth` operations.
+// Logging never allocates; once full, each new operation evicts the oldest one (counted in getDroppedCount).
 class RollbackManager {
 private:
-    std::stack<Operation> history;
+    std::vector<Operation> ring;
+    size_t next;  // Ring position the next operation is written to
+    size_t count; // Live operations, newest at next-1
+    unsigned long dropped;
 
 public:
-    void logOperation(Operation op);
-    // Returns the list of operations that were undone, so the System can assume state.
-    // However, the Manager might just tell the System *what* to undo.
-    // Better design: Manager takes the System context but System is too large.
-    // Let's return the Operations to be inverted by the System.
-    std::vector<Operation> rollback(int k);
+    static const size_t DEFAULT_DEPTH = 1024;
+
+    explicit RollbackManager(size_t depth = DEFAULT_DEPTH);
+
+    void logOperation(const Operation& op);
+    // Pops up to k of the newest operations so the System can invert them.
+    RollbackView rollback(int k);
+    RollbackView peek(int k) const; // Newest k operations without popping them (e.g. for checkpoints)
+
+    void setDepth(size_t depth); // Keeps the newest min(depth, size()) operations; evictions count as dropped
+    size_t getDepth() const;
+    size_t size() const;
+    unsigned long getDroppedCount() const;
+    void setDroppedCount(unsigned long n); // Restoring a checkpoint
+    // The request table was compacted: requestPos p becomes newPos[p] (never -1 for a logged request)
+    void remapRequests(const std::vector<int>& newPos);
 };
 
 #endif // ROLLBACK_MANAGER_H
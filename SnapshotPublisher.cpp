@@ -0,0 +1,25 @@
+#include "SnapshotPublisher.h"
+#include <chrono>
+
+SnapshotPublisher::SnapshotPublisher(ParkingSystem& ps, int ms) : system(ps), intervalMs(ms), stopping(false) {
+    system.enableConcurrency(); // Snapshots are now cut from another thread
+    worker = std::thread(&SnapshotPublisher::run, this);
+}
+
+SnapshotPublisher::~SnapshotPublisher() {
+    {
+        std::lock_guard<std::mutex> lock(stopLock);
+        stopping = true;
+    }
+    stopSignal.notify_one();
+    worker.join();
+}
+
+void SnapshotPublisher::run() {
+    std::unique_lock<std::mutex> lock(stopLock);
+    while (true) {
+        bool stop = stopSignal.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return stopping; });
+        if (system.getSnapshot()->getMutationCount() != system.getMutationCount()) system.publishSnapshot();
+        if (stop) return;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef SNAPSHOT_PUBLISHER_H
+#define SNAPSHOT_PUBLISHER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "ParkingSystem.h"
+
+// Interval alternative to ParkingSystem::setSnapshotOnCommit: a background thread publishes a
+// fresh snapshot every intervalMs, skipping intervals in which nothing was mutated.
+// Puts the system in concurrent mode.
+class SnapshotPublisher {
+private:
+    ParkingSystem& system;
+    int intervalMs;
+    bool stopping;
+    std::mutex stopLock;
+    std::condition_variable stopSignal;
+    std::thread worker;
+
+    void run();
+
+public:
+    SnapshotPublisher(ParkingSystem& ps, int intervalMs);
+    ~SnapshotPublisher(); // Stops the thread after a final publish
+
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+};
+
+#endif // SNAPSHOT_PUBLISHER_H
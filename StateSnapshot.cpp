@@ -0,0 +1,53 @@
+#include "StateSnapshot.h"
+
+StateSnapshot::StateSnapshot() : version(0), mutationCount(0), layout(std::make_shared<SnapshotLayout>()) {}
+
+void StateSnapshot::countOccupancy() {
+    const SnapshotLayout& l = *layout;
+    int areas = (int)l.areaIds.size();
+    areaOccupied.assign(areas, 0);
+    for (int a = 0; a < areas; ++a) {
+        // Popcount over the area's words, masking the partial words at both ends
+        int begin = l.areaSlotBegin[a];
+        int end = l.areaSlotBegin[a + 1];
+        for (int w = begin / 64; begin < end; ++w) {
+            int from = begin % 64;
+            int to = (end - w * 64 < 64) ? end - w * 64 : 64;
+            std::uint64_t mask = (to == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << to) - 1) & (~std::uint64_t(0) << from);
+            areaOccupied[a] += __builtin_popcountll(occupancyBits[w] & mask);
+            begin = w * 64 + to;
+        }
+    }
+
+    int zones = (int)l.zoneIds.size();
+    zoneOccupied.assign(zones, 0);
+    for (int z = 0; z < zones; ++z) {
+        for (int a = l.zoneAreaBegin[z]; a < l.zoneAreaBegin[z + 1]; ++a) zoneOccupied[z] += areaOccupied[a];
+    }
+}
+
+unsigned long StateSnapshot::getVersion() const { return version; }
+unsigned long StateSnapshot::getMutationCount() const { return mutationCount; }
+
+int StateSnapshot::getZoneCount() const { return (int)layout->zoneIds.size(); }
+int StateSnapshot::getZoneId(int z) const { return layout->zoneIds[z]; }
+int StateSnapshot::getZoneAreaBegin(int z) const { return layout->zoneAreaBegin[z]; }
+int StateSnapshot::getZoneAreaEnd(int z) const { return layout->zoneAreaBegin[z + 1]; }
+int StateSnapshot::getZoneOccupied(int z) const { return zoneOccupied[z]; }
+
+int StateSnapshot::getZoneCapacity(int z) const {
+    return layout->areaSlotBegin[getZoneAreaEnd(z)] - layout->areaSlotBegin[getZoneAreaBegin(z)];
+}
+
+int StateSnapshot::getAreaId(int a) const { return layout->areaIds[a]; }
+int StateSnapshot::getAreaSlotBegin(int a) const { return layout->areaSlotBegin[a]; }
+int StateSnapshot::getAreaSlotEnd(int a) const { return layout->areaSlotBegin[a + 1]; }
+int StateSnapshot::getAreaOccupied(int a) const { return areaOccupied[a]; }
+
+int StateSnapshot::getSlotCount() const { return (int)layout->slotIds.size(); }
+int StateSnapshot::getSlotId(int s) const { return layout->slotIds[s]; }
+bool StateSnapshot::isOccupied(int s) const { return (occupancyBits[s / 64] >> (s % 64)) & 1; }
+
+const std::vector<ParkingRequest>& StateSnapshot::getRequests() const {
+    return requests;
+}
@@ -0,0 +1,59 @@
+#ifndef STATE_SNAPSHOT_H
+#define STATE_SNAPSHOT_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "ParkingRequest.h"
+
+// City structure as of a snapshot. The city only grows by appending, so snapshots share one
+// copy until a zone, area or slot is added.
+struct SnapshotLayout {
+    std::vector<int> zoneIds;
+    std::vector<int> zoneAreaBegin; // size zones+1
+    std::vector<int> areaIds;
+    std::vector<int> areaSlotBegin; // size areas+1
+    std::vector<int> slotIds;
+};
+
+// Immutable, self-consistent copy of a ParkingSystem's state (see ParkingSystem::publishSnapshot).
+// Readers hold it through a shared_ptr for as long as they like; writers are never blocked by them.
+class StateSnapshot {
+private:
+    unsigned long version;       // Publish sequence number, increases by one per snapshot
+    unsigned long mutationCount; // ParkingSystem::getMutationCount() at the cut
+    std::shared_ptr<const SnapshotLayout> layout;
+    std::vector<std::uint64_t> occupancyBits;
+    std::vector<int> areaOccupied; // Derived from occupancyBits, so counts always match the slots
+    std::vector<int> zoneOccupied;
+    std::vector<ParkingRequest> requests;
+
+    friend class ParkingSystem;
+    void countOccupancy();
+
+public:
+    StateSnapshot();
+
+    unsigned long getVersion() const;
+    unsigned long getMutationCount() const;
+
+    int getZoneCount() const;
+    int getZoneId(int z) const;
+    int getZoneAreaBegin(int z) const;
+    int getZoneAreaEnd(int z) const;
+    int getZoneCapacity(int z) const;
+    int getZoneOccupied(int z) const;
+
+    int getAreaId(int a) const;
+    int getAreaSlotBegin(int a) const;
+    int getAreaSlotEnd(int a) const;
+    int getAreaOccupied(int a) const;
+
+    int getSlotCount() const;
+    int getSlotId(int s) const;
+    bool isOccupied(int s) const;
+
+    const std::vector<ParkingRequest>& getRequests() const;
+};
+
+#endif // STATE_SNAPSHOT_H
@@ -0,0 +1,343 @@
+#include "WriteAheadLog.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::uint32_t checksum(const char* data, size_t n) {
+    std::uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+template <typename T>
+void put(std::vector<char>& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool get(const std::vector<char>& in, size_t& pos, T& value) {
+    if (pos + sizeof(T) > in.size()) return false;
+    std::memcpy(&value, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+// Request image fields, shared by REQUEST records and the images inside ROLLBACK records
+void putRequest(std::vector<char>& out, const ParkingRequest& req) {
+    put(out, (std::int32_t)req.getRequestId());
+    put(out, (std::int32_t)req.getRequestedZoneId());
+    put(out, (std::int32_t)req.getState());
+    put(out, (std::int32_t)req.getAssignedSlotId());
+    put(out, (std::int32_t)req.getAssignedZoneId());
+    put(out, (std::int64_t)req.getRequestTime());
+    put(out, (std::int64_t)req.getEndTime());
+    const std::string vehicleId = req.getVehicleId();
+    put(out, (std::uint32_t)vehicleId.size());
+    out.insert(out.end(), vehicleId.begin(), vehicleId.end());
+}
+
+bool getRequest(const std::vector<char>& in, size_t& pos, WalRecord& rec) {
+    std::int32_t id, zone, state, slot, assignedZone;
+    std::int64_t start, end;
+    std::uint32_t nameLength;
+    if (!get(in, pos, id) || !get(in, pos, zone) || !get(in, pos, state) || !get(in, pos, slot) ||
+        !get(in, pos, assignedZone) || !get(in, pos, start) || !get(in, pos, end) || !get(in, pos, nameLength) ||
+        nameLength > in.size() - pos) {
+        return false;
+    }
+    rec.type = WalRecord::REQUEST;
+    rec.requestId = id;
+    rec.requestedZoneId = zone;
+    rec.state = (RequestState)state;
+    rec.slotId = slot;
+    rec.zoneId = assignedZone;
+    rec.requestTime = (time_t)start;
+    rec.endTime = (time_t)end;
+    rec.vehicleId.assign(in.data() + pos, nameLength);
+    pos += nameLength;
+    return true;
+}
+
+bool readFully(int fd, char* buf, size_t n) {
+    while (n > 0) {
+        ssize_t got = ::read(fd, buf, n);
+        if (got <= 0) return false;
+        buf += got;
+        n -= (size_t)got;
+    }
+    return true;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog()
+    : fd(-1), groupRecords(1), groupMs(1), pendingRecords(0), appendedSeq(0), durableSeq(0), durableBytes(0),
+      syncCount(0), writeFailures(0), failing(false), syncRequested(false), stopping(false), writeFn(::write) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+bool WriteAheadLog::open(const std::string& file, long validLength, int records, int ms) {
+    path = file;
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd == -1) return false;
+    if (::ftruncate(fd, validLength) != 0 || ::lseek(fd, validLength, SEEK_SET) != validLength) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    durableBytes = validLength;
+    groupRecords = records > 0 ? records : 1;
+    groupMs = ms > 0 ? ms : 1;
+    stopping = false;
+    flusher = std::thread(&WriteAheadLog::run, this);
+    return true;
+}
+
+void WriteAheadLog::close() {
+    if (fd == -1) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    flushNeeded.notify_one();
+    flusher.join();
+    ::close(fd);
+    fd = -1;
+}
+
+void WriteAheadLog::append(const std::vector<char>& payload) {
+    std::uint32_t length = (std::uint32_t)payload.size();
+    std::uint32_t sum = checksum(payload.data(), payload.size());
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        put(pending, length);
+        put(pending, sum);
+        pending.insert(pending.end(), payload.begin(), payload.end());
+        appendedSeq++;
+        wake = ++pendingRecords >= groupRecords;
+    }
+    if (wake) flushNeeded.notify_one();
+}
+
+void WriteAheadLog::appendRequest(const ParkingRequest& req) {
+    std::vector<char> payload;
+    payload.reserve(48 + req.getVehicleId().size());
+    put(payload, (std::uint8_t)WalRecord::REQUEST);
+    putRequest(payload, req);
+    append(payload);
+}
+
+void WriteAheadLog::appendOperation(const Operation& op) {
+    // Handles (slotIndex, requestPos) are process-local and recomputed on replay
+    std::vector<char> payload;
+    put(payload, (std::uint8_t)WalRecord::OPERATION);
+    put(payload, (std::int32_t)op.type);
+    put(payload, (std::int32_t)op.requestId);
+    put(payload, (std::int32_t)op.slotId);
+    put(payload, (std::int32_t)op.zoneId);
+    append(payload);
+}
+
+void WriteAheadLog::appendRollback(int count, const std::vector<ParkingRequest>& images) {
+    std::vector<char> payload;
+    payload.reserve(16 + images.size() * 48);
+    put(payload, (std::uint8_t)WalRecord::ROLLBACK);
+    put(payload, (std::int32_t)count);
+    put(payload, (std::uint32_t)images.size());
+    for (const ParkingRequest& req : images) putRequest(payload, req);
+    append(payload);
+}
+
+void WriteAheadLog::appendSegmentHeader(unsigned long generation) {
+    std::vector<char> payload;
+    put(payload, (std::uint8_t)WalRecord::SEGMENT);
+    put(payload, (std::uint64_t)generation);
+    append(payload);
+}
+
+bool WriteAheadLog::rotate(const std::string& segmentPath, unsigned long generation) {
+    if (fd == -1) return false;
+    if (!sync()) return false; // Nothing is pending afterwards, so the flusher is idle until the next append
+    if (::rename(path.c_str(), segmentPath.c_str()) != 0) return false;
+    int fresh = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fresh == -1) {
+        ::rename(segmentPath.c_str(), path.c_str());
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ::close(fd);
+        fd = fresh;
+        durableBytes = 0;
+    }
+    appendSegmentHeader(generation);
+    return true;
+}
+
+bool WriteAheadLog::sync() {
+    std::unique_lock<std::mutex> guard(lock);
+    if (fd == -1) return true;
+    unsigned long target = appendedSeq;
+    unsigned long failures = writeFailures;
+    syncRequested = true;
+    flushNeeded.notify_one();
+    flushed.wait(guard, [&]() { return durableSeq >= target || writeFailures != failures; });
+    return durableSeq >= target;
+}
+
+void WriteAheadLog::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        flushNeeded.wait_for(guard, std::chrono::milliseconds(groupMs),
+                             [this]() { return stopping || syncRequested || (!failing && pendingRecords >= groupRecords); });
+        if (!pending.empty()) {
+            // Hand the batch over and write it without holding the lock, so appenders never wait on the disk
+            writing.swap(pending);
+            pendingRecords = 0;
+            unsigned long batchEnd = appendedSeq;
+            ssize_t (*writeBatch)(int, const void*, size_t) = writeFn;
+            guard.unlock();
+
+            size_t done = 0;
+            while (done < writing.size()) {
+                ssize_t n = writeBatch(fd, writing.data() + done, writing.size() - done);
+                if (n <= 0) break;
+                done += (size_t)n;
+            }
+            bool ok = done == writing.size() && ::fdatasync(fd) == 0; // One fsync for the whole group
+            if (!ok) {
+                // Cut the partial batch off so the next write doesn't land after a torn record
+                if (::ftruncate(fd, durableBytes) != 0 || ::lseek(fd, durableBytes, SEEK_SET) != durableBytes) {
+                    std::cout << "[System] WAL could not be truncated after a failed write" << std::endl;
+                }
+            }
+
+            guard.lock();
+            syncCount++;
+            if (ok) {
+                durableSeq = batchEnd;
+                durableBytes += (long)writing.size();
+                failing = false;
+                writing.clear();
+            } else {
+                // Keep the batch ahead of anything appended meanwhile and retry it with the next group
+                if (!failing) std::cout << "[System] WAL write failed, " << (batchEnd - durableSeq) << " records not durable yet" << std::endl;
+                failing = true;
+                writeFailures++;
+                pendingRecords += (int)(batchEnd - durableSeq);
+                writing.insert(writing.end(), pending.begin(), pending.end());
+                writing.swap(pending);
+                writing.clear();
+                if (stopping) { // Closing: give up on what can't be written
+                    flushed.notify_all();
+                    return;
+                }
+            }
+        }
+        syncRequested = false;
+        flushed.notify_all();
+        if (stopping && pending.empty()) return;
+    }
+}
+
+unsigned long WriteAheadLog::getRecordsAppended() {
+    std::lock_guard<std::mutex> guard(lock);
+    return appendedSeq;
+}
+
+unsigned long WriteAheadLog::getSyncCount() {
+    std::lock_guard<std::mutex> guard(lock);
+    return syncCount;
+}
+
+unsigned long WriteAheadLog::getWriteFailures() {
+    std::lock_guard<std::mutex> guard(lock);
+    return writeFailures;
+}
+
+void WriteAheadLog::setWriteFunction(ssize_t (*write)(int, const void*, size_t)) {
+    std::lock_guard<std::mutex> guard(lock);
+    writeFn = write;
+}
+
+WalReader::WalReader(const std::string& path) : validLength(0), fileLength(0) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd != -1 && ::fstat(fd, &st) == 0) fileLength = (long)st.st_size;
+}
+
+bool WalReader::isOpen() const {
+    return fd != -1;
+}
+
+WalReader::~WalReader() {
+    if (fd != -1) ::close(fd);
+}
+
+bool WalReader::next(WalRecord& rec) {
+    if (fd == -1) return false;
+    char header[8];
+    if (!readFully(fd, header, sizeof(header))) return false;
+    std::uint32_t length;
+    std::uint32_t sum;
+    std::memcpy(&length, header, 4);
+    std::memcpy(&sum, header + 4, 4);
+    // Garbage length: treat as torn tail rather than allocating for it
+    if (length == 0 || (long)length > fileLength - validLength - 8) return false;
+    payload.resize(length);
+    if (!readFully(fd, payload.data(), length)) return false;
+    if (checksum(payload.data(), length) != sum) return false;
+
+    size_t pos = 0;
+    std::uint8_t type = 0;
+    get(payload, pos, type);
+    bool ok = false;
+    if (type == WalRecord::REQUEST) {
+        ok = getRequest(payload, pos, rec) && pos == payload.size();
+    } else if (type == WalRecord::OPERATION) {
+        std::int32_t opType, id, slot, zone;
+        ok = get(payload, pos, opType) && get(payload, pos, id) && get(payload, pos, slot) && get(payload, pos, zone);
+        if (ok) {
+            rec.type = WalRecord::OPERATION;
+            rec.op = Operation{(Operation::Type)opType, id, slot, zone, -1, -1};
+        }
+    } else if (type == WalRecord::ROLLBACK) {
+        std::int32_t count;
+        std::uint32_t imageCount;
+        ok = get(payload, pos, count) && get(payload, pos, imageCount) && imageCount <= payload.size() - pos;
+        if (ok) {
+            rec.type = WalRecord::ROLLBACK;
+            rec.count = count;
+            rec.images.resize(imageCount);
+            for (WalRecord& image : rec.images) ok = ok && getRequest(payload, pos, image);
+            ok = ok && pos == payload.size();
+        }
+    } else if (type == WalRecord::SEGMENT) {
+        std::uint64_t generation;
+        ok = get(payload, pos, generation);
+        if (ok) {
+            rec.type = WalRecord::SEGMENT;
+            rec.generation = (unsigned long)generation;
+        }
+    }
+    if (!ok) return false;
+    validLength += 8 + (long)length;
+    return true;
+}
+
+long WalReader::getValidLength() const {
+    return validLength;
+}
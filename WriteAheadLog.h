@@ -0,0 +1,122 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include "ParkingRequest.h"
+#include "RollbackManager.h"
+
+// One decoded log record (see WriteAheadLog for the encoding)
+struct WalRecord {
+    enum Type { REQUEST = 1, OPERATION = 2, ROLLBACK = 3, SEGMENT = 4 };
+    Type type;
+
+    // REQUEST: full image of a request after a change (creation, allocation, cancel, leave, undo)
+    int requestId;
+    std::string vehicleId;
+    int requestedZoneId;
+    RequestState state;
+    int slotId;
+    int zoneId;
+    time_t requestTime;
+    time_t endTime;
+
+    Operation op; // OPERATION: entry appended to the rollback history
+    int count;    // ROLLBACK: number of entries popped from the rollback history
+    std::vector<WalRecord> images; // ROLLBACK: the undone requests' images (REQUEST records), applied with the pop
+    unsigned long generation; // SEGMENT: first record of a segment, numbering it (see ParkingSystem::writeCheckpoint)
+};
+
+// Append-only binary log of every state change, written with group commit:
+// records are buffered and a background thread writes and fsyncs them every groupMs,
+// or as soon as groupRecords are pending. A crash loses at most that window.
+// Record layout: [u32 payload length][u32 FNV-1a checksum of payload][payload], payload[0] = WalRecord::Type.
+class WriteAheadLog {
+private:
+    std::string path;
+    int fd;
+    int groupRecords;
+    int groupMs;
+
+    std::mutex lock;
+    std::condition_variable flushNeeded;
+    std::condition_variable flushed;
+    std::vector<char> pending;  // Encoded records not yet handed to the flusher
+    std::vector<char> writing;  // Buffer being written by the flusher
+    int pendingRecords;
+    unsigned long appendedSeq;  // Records appended so far
+    unsigned long durableSeq;   // Records written and fsynced so far
+    long durableBytes;          // File offset just past the last fsynced batch
+    unsigned long syncCount;
+    unsigned long writeFailures;
+    bool failing;               // The last batch failed and is queued again
+    bool syncRequested;
+    bool stopping;
+    ssize_t (*writeFn)(int, const void*, size_t); // ::write unless a test replaced it
+    std::thread flusher;
+
+    void append(const std::vector<char>& payload);
+    void run();
+
+public:
+    WriteAheadLog();
+    ~WriteAheadLog(); // close()
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Opens (creating if needed) for appending; validLength cuts off a torn tail found by WalReader
+    bool open(const std::string& path, long validLength, int groupRecords, int groupMs);
+    void close(); // Flushes and fsyncs everything appended, then stops the flusher
+
+    void appendRequest(const ParkingRequest& req);
+    void appendOperation(const Operation& op);
+    // One record for the whole undo, so a crash can never keep the pop without the reverted requests
+    void appendRollback(int count, const std::vector<ParkingRequest>& images);
+    void appendSegmentHeader(unsigned long generation);
+
+    // Moves everything logged so far to segmentPath and continues in a fresh file at the original
+    // path, starting with a header for `generation`. The caller must keep appends out meanwhile.
+    bool rotate(const std::string& segmentPath, unsigned long generation);
+
+    // Blocks until everything appended so far is on disk; false if a write or fsync failed meanwhile.
+    // A failed batch is cut off the file and retried with the next one, so the log never has a gap.
+    bool sync();
+
+    unsigned long getRecordsAppended();
+    unsigned long getSyncCount();
+    unsigned long getWriteFailures();
+
+    // Replaces ::write for the flusher, so tests can make writes fail or stop part way
+    void setWriteFunction(ssize_t (*write)(int fd, const void* buf, size_t n));
+};
+
+// Sequential reader used for recovery. Stops at the end of the file or at the first
+// torn/corrupt record; getValidLength() is the offset just past the last good record.
+class WalReader {
+private:
+    int fd;
+    long validLength;
+    long fileLength;
+    std::vector<char> payload;
+
+public:
+    explicit WalReader(const std::string& path); // A missing file reads as empty
+    ~WalReader();
+
+    bool isOpen() const; // False if the file does not exist
+
+    WalReader(const WalReader&) = delete;
+    WalReader& operator=(const WalReader&) = delete;
+
+    bool next(WalRecord& rec);
+    long getValidLength() const;
+};
+
+#endif // WRITE_AHEAD_LOG_H
@@ -1,28 +1,39 @@
 #include "Zone.h"
 
-Zone::Zone(int id) : zoneId(id) {}
+Zone::Zone(CityLayout* c, int zoneIndex) : city(c), index(zoneIndex) {}
 
-void Zone::addParkingArea(const ParkingArea& area) {
-    areas.push_back(area);
+ParkingArea Zone::addParkingArea(int areaId) {
+    return ParkingArea(city, city->addArea(index, areaId));
 }
 
 void Zone::addAdjacentZone(int neighborId) {
-    // Avoid duplicates if necessary, but for now simple push
-    adjacentZoneIds.push_back(neighborId);
+    city->addAdjacency(index, neighborId);
 }
 
 int Zone::getZoneId() const {
-    return zoneId;
+    return city->getZoneId(index);
 }
 
-const std::vector<ParkingArea>& Zone::getParkingAreas() const {
-    return areas;
+int Zone::getIndex() const {
+    return index;
 }
 
-std::vector<ParkingArea>& Zone::getParkingAreasMutable() {
-    return areas;
+ViewRange<ParkingArea> Zone::getParkingAreas() const {
+    return ViewRange<ParkingArea>(city, city->getZoneAreaBegin(index), city->getZoneAreaEnd(index));
 }
 
 const std::vector<int>& Zone::getAdjacentZones() const {
-    return adjacentZoneIds;
+    return city->getAdjacentZones(index);
+}
+
+int Zone::getCapacity() const {
+    return city->getZoneCapacity(index);
+}
+
+int Zone::getOccupiedCount() const {
+    return city->getZoneOccupied(index);
+}
+
+bool Zone::isFull() const {
+    return getOccupiedCount() >= getCapacity();
 }
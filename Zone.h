@@ -2,24 +2,30 @@
 #define ZONE_H
 
 #include <vector>
+#include "CityLayout.h"
 #include "ParkingArea.h"
 
+// Lightweight view of one zone in a CityLayout
 class Zone {
 private:
-    int zoneId;
-    std::vector<ParkingArea> areas;
-    std::vector<int> adjacentZoneIds; // Adjacency list by ID
+    CityLayout* city;
+    int index; // Zone index in the city's zone columns
 
 public:
-    Zone(int id);
+    Zone(CityLayout* c, int zoneIndex);
 
-    void addParkingArea(const ParkingArea& area);
+    ParkingArea addParkingArea(int areaId); // Only valid on the most recently added zone
     void addAdjacentZone(int neighborId);
     
     int getZoneId() const;
-    const std::vector<ParkingArea>& getParkingAreas() const;
-    std::vector<ParkingArea>& getParkingAreasMutable();
+    int getIndex() const;
+    ViewRange<ParkingArea> getParkingAreas() const;
     const std::vector<int>& getAdjacentZones() const;
+
+    // Live counters, O(1)
+    int getCapacity() const;
+    int getOccupiedCount() const;
+    bool isFull() const;
 };
 
 #endif // ZONE_H
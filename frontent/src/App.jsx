@@ -1,8 +1,39 @@
-import React, { useState, useEffect } from 'react';
+import React, { useState, useEffect, useRef } from 'react';
 import { Car, Zap, Activity, Clock, Shield, Map, Monitor, Database, Radio, X, Octagon, RotateCcw } from 'lucide-react';
 
+// Merges a delta from /api/data?since= into the last known state
+function applyDelta(prev, delta) {
+  const occupied = new Map(delta.slots.map(s => [s.id, s.occupied]));
+  const zones = occupied.size === 0 ? prev.zones : prev.zones.map(z => ({
+    ...z,
+    areas: z.areas.map(a => ({
+      ...a,
+      slots: a.slots.map(s => occupied.has(s.id) ? { ...s, occupied: occupied.get(s.id) } : s)
+    }))
+  }));
+  const requests = prev.requests.slice();
+  const position = new Map(requests.map((r, i) => [r.id, i]));
+  for (const r of delta.requests) {
+    if (position.has(r.id)) requests[position.get(r.id)] = r;
+    else requests.push(r);
+  }
+  return { ...prev, version: delta.version, zones, requests };
+}
+
+// Applies one pushed request change: the request's old slot is freed and its new one taken
+function applyEvent(prev, event) {
+  const r = event.request;
+  const old = prev.requests.find(x => x.id === r.id);
+  const active = q => q && (q.state === 'ALLOCATED' || q.state === 'OCCUPIED');
+  const slots = [];
+  if (active(old)) slots.push({ id: old.slotId, occupied: false });
+  if (active(r)) slots.push({ id: r.slotId, occupied: true });
+  return applyDelta(prev, { version: prev.version, slots, requests: [r] });
+}
+
 export default function App() {
   const [data, setData] = useState(null);
+  const dataRef = useRef(null);
   const [booting, setBooting] = useState(true);
   const [bootProgress, setBootProgress] = useState(0);
   const [vehicleId, setVehicleId] = useState('');
@@ -26,18 +57,47 @@ export default function App() {
 
   const fetchData = async () => {
     try {
-      const res = await fetch('http://localhost:8080/api/data');
+      const prev = dataRef.current;
+      const query = prev ? `?since=${prev.version}&epoch=${prev.epoch}` : '';
+      const res = await fetch('http://localhost:8080/api/data' + query);
       if (!res.ok) throw new Error("Failed");
-      setData(await res.json());
+      const next = await res.json();
+      const current = dataRef.current;
+      // Overlapping polls can finish out of order; never go back in time
+      if (current && next.epoch === current.epoch && next.version < current.version) return;
+      const merged = next.full ? next : applyDelta(current, next);
+      dataRef.current = merged;
+      setData(merged);
     } catch (e) { console.error(e); }
   };
 
   useEffect(() => {
-    if (!booting) {
-      fetchData();
-      const interval = setInterval(fetchData, 1500);
-      return () => clearInterval(interval);
-    }
+    if (booting) return;
+    fetchData();
+    let pollMs = 1500;
+    let interval = setInterval(fetchData, pollMs);
+    const setPolling = ms => {
+      if (ms === pollMs) return;
+      pollMs = ms;
+      clearInterval(interval);
+      interval = setInterval(fetchData, ms);
+    };
+
+    // Pushed changes keep the view current; polling drops to a slow safety net while the stream is up
+    const source = new EventSource('http://localhost:8080/api/events');
+    source.onopen = () => setPolling(15000);
+    source.onerror = () => setPolling(1500);
+    source.onmessage = e => {
+      if (!dataRef.current) return;
+      const merged = applyEvent(dataRef.current, JSON.parse(e.data));
+      dataRef.current = merged;
+      setData(merged);
+    };
+    source.addEventListener('resync', fetchData);
+    return () => {
+      source.close();
+      clearInterval(interval);
+    };
   }, [booting]);
 
   const handleRequest = async (e) => {
@@ -1,45 +1,66 @@
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <set>
+#include <atomic>
+#include <algorithm>
+#include <future>
+#include <fstream>
+#include <cstdio>
+#include <sstream>
+#include <cerrno>
+#include <unistd.h>
 #include "ParkingSystem.h"
 #include "Zone.h"
 #include "ParkingArea.h"
 #include "ParkingSlot.h"
+#include "RollbackManager.h"
+#include "CommandPipeline.h"
+#include "SnapshotPublisher.h"
+#include "Checkpointer.h"
+#include "DataJsonCache.h"
 
 // Helper to setup a small city
 ParkingSystem setupCity() {
     ParkingSystem ps;
 
     // Zone 1: 1 Area, 2 Slots (ID 1, 2)
-    Zone z1(1);
-    ParkingArea a1(101);
-    a1.addSlot(ParkingSlot(1, 1));
-    a1.addSlot(ParkingSlot(2, 1));
-    z1.addParkingArea(a1);
+    Zone z1 = ps.addZone(1);
+    ParkingArea a1 = z1.addParkingArea(101);
+    a1.addSlot(1);
+    a1.addSlot(2);
     z1.addAdjacentZone(2); // Connected to Zone 2
 
     // Zone 2: 1 Area, 1 Slot (ID 3)
-    Zone z2(2);
-    ParkingArea a2(201);
-    a2.addSlot(ParkingSlot(3, 2));
-    z2.addParkingArea(a2);
+    Zone z2 = ps.addZone(2);
+    ParkingArea a2 = z2.addParkingArea(201);
+    a2.addSlot(3);
     z2.addAdjacentZone(1); // Connected to Zone 1
 
     // Zone 3: Isolated, 1 Slot (ID 4)
-    Zone z3(3);
-    ParkingArea a3(301);
-    a3.addSlot(ParkingSlot(4, 3));
-    z3.addParkingArea(a3);
-
-    ps.addZone(z1);
-    ps.addZone(z2);
-    ps.addZone(z3);
+    Zone z3 = ps.addZone(3);
+    ParkingArea a3 = z3.addParkingArea(301);
+    a3.addSlot(4);
 
     return ps;
 }
 
-void runTests() {
-    std::cout << "Starting Test Suite..." << std::endl;
+const char* strategyName(AllocationStrategy strategy) {
+    switch (strategy) {
+        case AllocationStrategy::LINEAR_SCAN: return "linear scan";
+        case AllocationStrategy::BITMAP: return "bitmap";
+        case AllocationStrategy::FREE_LIST: return "free list";
+    }
+    return "unknown";
+}
+
+void runTests(AllocationStrategy strategy) {
+    AllocationEngine::setStrategy(strategy);
+    std::cout << "Starting Test Suite (" << strategyName(strategy) << ")..." << std::endl;
     ParkingSystem ps = setupCity();
 
     // Test 1: Normal Allocation (Zone 1)
@@ -71,6 +92,8 @@ void runTests() {
     std::cout << "\nTest 6: Cancellation of Request 2\n";
     bool c6 = ps.cancelRequest(r2);
     assert(c6 == true);
+    assert(ps.cancelRequest(r2) == false);     // Already cancelled
+    assert(ps.cancelRequest(r1 - 1) == false); // Not part of this system
     // Slot from r2 should be free now (Zone 1 has 1 free slot)
 
     // Test 7: Re-allocation after Cancellation
@@ -107,7 +130,1587 @@ void runTests() {
     ps.printAnalytics();
 }
 
-int main() {
-    runTests();
+// Bitmap search must work across 64-bit word boundaries, including areas that start mid-word
+void testBitmapAcrossWords() {
+    std::cout << "\nTest: Bitmap search across words\n";
+    CityLayout city;
+    Zone zone(&city, city.addZone(9));
+    ParkingArea area = zone.addParkingArea(900);
+    for (int i = 0; i < 130; ++i) area.addSlot(1000 + i);
+    ParkingArea tail = zone.addParkingArea(901); // Starts at slot index 130 (bit 2 of word 2)
+    for (int i = 0; i < 70; ++i) tail.addSlot(2000 + i);
+    assert(!zone.addParkingArea(901).addSlot(1000)); // Duplicate slot ID rejected
+
+    for (ParkingSlot s : area.getSlots()) s.occupy();
+    assert(area.findFreeSlotIndex() == -1);
+    assert(tail.findFreeSlotIndex() == 130);
+
+    area.getSlots()[100].release();
+    assert(area.findFreeSlotIndex() == 100);
+    tail.getSlots()[0].occupy();
+    tail.getSlots()[1].occupy();
+    assert(tail.findFreeSlotIndex() == 132);
+
+    // Area and zone counters follow occupy/release on the slot views
+    assert(area.getOccupiedCount() == 129 && tail.getOccupiedCount() == 2);
+    assert(zone.getCapacity() == 200 && zone.getOccupiedCount() == 131);
+    area.getSlots()[100].occupy();
+    area.getSlots()[100].occupy(); // Repeated occupy is not double counted
+    assert(area.isFull() && zone.getOccupiedCount() == 132);
+
+    CityLayout copy = city; // Copies keep their own columns
+    Zone(&copy, 0).getParkingAreas()[0].getSlots()[0].release();
+    assert(Zone(&copy, 0).getOccupiedCount() == 131 && zone.getOccupiedCount() == 132);
+    std::cout << "Bitmap search OK\n";
+}
+
+// Free list is LIFO and stays consistent with slots occupied outside the allocator
+void testFreeList() {
+    std::cout << "\nTest: Area free list\n";
+    CityLayout city;
+    Zone zone(&city, city.addZone(9));
+    zone.addParkingArea(900).addSlot(1999); // Earlier area, so the tested stack does not start at 0
+    ParkingArea area = zone.addParkingArea(901);
+    for (int i = 0; i < 4; ++i) area.addSlot(2000 + i);
+    ViewRange<ParkingSlot> slots = area.getSlots();
+    assert(area.peekFreeList() == slots[3].getIndex());
+
+    slots[3].occupy();
+    slots[1].occupy(); // Not the top of the list (e.g. rollback re-occupy)
+    assert(area.peekFreeList() == slots[2].getIndex());
+    slots[2].occupy();
+    slots[0].occupy();
+    assert(area.peekFreeList() == -1);
+
+    slots[1].release();
+    slots[3].release();
+    assert(area.peekFreeList() == slots[3].getIndex()); // Most recently released first
+    std::cout << "Free list OK\n";
+}
+
+// Cross-zone fallback reaches zones two hops away and honours the hop limit
+void testMultiHopFallback() {
+    std::cout << "\nTest: Multi-hop cross-zone fallback\n";
+    CityLayout city;
+    for (int id = 1; id <= 4; ++id) {
+        Zone z(&city, city.addZone(id)); // Chain 1 - 2 - 3 - 4, one slot each
+        z.addParkingArea(id * 100).addSlot(id);
+        if (id > 1) z.addAdjacentZone(id - 1);
+        if (id < 4) z.addAdjacentZone(id + 1);
+    }
+
+    assert(AllocationEngine::allocateSlot(1, city).slotId == 1);
+    AllocationResult r = AllocationEngine::allocateSlot(1, city);
+    assert(r.success && r.zoneId == 2 && r.hops == 1);
+
+    AllocationEngine::setMaxCrossZoneHops(1);
+    assert(!AllocationEngine::allocateSlot(1, city).success); // Zone 3 is two hops away
+    AllocationEngine::setMaxCrossZoneHops(3);
+    r = AllocationEngine::allocateSlot(1, city);
+    assert(r.success && r.zoneId == 3 && r.hops == 2);
+    r = AllocationEngine::allocateSlot(1, city);
+    assert(r.success && r.zoneId == 4 && r.hops == 3);
+    assert(!AllocationEngine::allocateSlot(1, city).success);
+
+    // Freeing zone 3 crosses zero, so the cached "nothing free" answer is refreshed
+    city.releaseSlot(city.findSlotIndex(3));
+    r = AllocationEngine::allocateSlot(1, city);
+    assert(r.success && r.zoneId == 3);
+
+    // Caches are invalidated per zone: only crossings within search reach make them stale
+    CityLayout islands;
+    for (int id = 1; id <= 4; ++id) { // Two separate pairs: 1 - 2 and 3 - 4, one slot each
+        Zone z(&islands, islands.addZone(id));
+        z.addParkingArea(id * 100).addSlot(id);
+        z.addAdjacentZone(id % 2 ? id + 1 : id - 1);
+    }
+    assert(AllocationEngine::allocateSlot(1, islands).slotId == 1);
+    assert(AllocationEngine::allocateSlot(1, islands).zoneId == 2); // Caches zone 1's "nothing free" after this
+    assert(!AllocationEngine::allocateSlot(1, islands).success);
+    int target, hops;
+    assert(islands.getCachedNearestFree(0, target, hops) && target == -1);
+    islands.occupySlot(islands.findSlotIndex(3)); // Zone 3 fills: unrelated to zone 1
+    assert(islands.getCachedNearestFree(0, target, hops));
+    islands.releaseSlot(islands.findSlotIndex(2)); // Zone 2 frees: zone 1's answer is stale
+    assert(!islands.getCachedNearestFree(0, target, hops));
+
+    // A crossing during a search leaves the answer it stores stale
+    NearestFreeStamp stamp = islands.stampNearestFree(0, 3);
+    islands.occupySlot(islands.findSlotIndex(2));
+    islands.setCachedNearestFree(0, 1, 1, stamp);
+    assert(!islands.getCachedNearestFree(0, target, hops));
+    assert(!AllocationEngine::allocateSlot(1, islands).success);
+    std::cout << "Multi-hop fallback OK\n";
+}
+
+// Batch arrivals are grouped per zone, spill over to neighbours, and keep input order in the returned IDs
+void testBatchAllocation() {
+    std::cout << "\nTest: Batch allocation\n";
+    ParkingSystem ps = setupCity();
+    std::vector<ParkingRequestSpec> batch = {{"B1", 3}, {"B2", 1}, {"B3", 1}, {"B4", 3}, {"B5", 1}, {"B6", 9}};
+    std::vector<int> ids = ps.requestParkingBatch(batch);
+    assert(ids.size() == batch.size());
+    for (size_t i = 1; i < ids.size(); ++i) assert(ids[i] == ids[i - 1] + 1);
+
+    const auto& reqs = ps.getRequests();
+    assert(reqs[0].getAssignedZoneId() == 3);                            // B1 takes zone 3's only slot
+    assert(reqs[1].getAssignedZoneId() == 1 && reqs[2].getAssignedZoneId() == 1);
+    assert(reqs[4].getAssignedZoneId() == 2);                            // B5 spills to neighbour zone 2
+    assert(reqs[3].getState() == RequestState::REQUESTED);               // B4: zone 3 full, isolated
+    assert(reqs[5].getState() == RequestState::REQUESTED);               // B6: unknown zone
+
+    ps.rollbackOperations(1); // Operations are logged in input order, so this undoes B5
+    assert(ps.getRequests()[4].getState() == RequestState::REQUESTED);
+    std::cout << "Batch allocation OK\n";
+}
+
+// One zone per worker thread, no adjacency, `slotsPerZone` slots each
+ParkingSystem setupShardedCity(int zones, int slotsPerZone) {
+    ParkingSystem ps;
+    for (int z = 0; z < zones; ++z) {
+        ParkingArea area = ps.addZone(z + 1).addParkingArea(z + 1);
+        for (int i = 0; i < slotsPerZone; ++i) area.addSlot(z * slotsPerZone + i + 1);
+    }
+    return ps;
+}
+
+void testConcurrentZones() {
+    const int threadCount = 4;
+    const int slotsPerZone = 100;
+    ParkingSystem ps = setupShardedCity(threadCount, slotsPerZone);
+    ps.enableConcurrency();
+    ps.setLogging(false);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&ps, t]() {
+            std::vector<int> ids;
+            for (int i = 0; i < slotsPerZone; ++i) ids.push_back(ps.requestParking("T" + std::to_string(t), t + 1));
+            for (int i = 0; i < slotsPerZone / 2; ++i) assert(ps.leaveParking(ids[i]));
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    assert(ps.getRequests().size() == (size_t)(threadCount * slotsPerZone));
+    std::set<int> ids;
+    for (const auto& req : ps.getRequests()) ids.insert(req.getRequestId());
+    assert(ids.size() == ps.getRequests().size()); // No ID handed out twice
+    for (Zone z : ps.getZones()) assert(z.getOccupiedCount() == slotsPerZone / 2);
+
+    ps.rollbackOperations(10);
+    int occupied = 0;
+    for (Zone z : ps.getZones()) occupied += z.getOccupiedCount();
+    assert(occupied == threadCount * slotsPerZone / 2 - 10);
+    std::cout << "Concurrent zones OK\n";
+}
+
+// Threads hammer one zone through the lock-free CAS path; every claim is recorded in a per-slot
+// holder count, so a slot handed out twice trips the assert
+void testLockFreeClaiming() {
+    const int threadCount = 8;
+    const int rounds = 20000;
+    CityLayout city;
+    Zone zone(&city, city.addZone(1));
+    ParkingArea a1 = zone.addParkingArea(1);
+    for (int i = 0; i < 100; ++i) a1.addSlot(i + 1);  // Areas end mid-word
+    ParkingArea a2 = zone.addParkingArea(2);
+    for (int i = 0; i < 60; ++i) a2.addSlot(i + 101);
+    city.setZoneLocking(true);
+    city.setLockFreeClaiming(true);
+
+    std::vector<std::atomic<int>> holders(city.getSlotCount());
+    std::atomic<int> doubleClaims(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&]() {
+            std::vector<int> held;
+            for (int i = 0; i < rounds; ++i) {
+                AllocationResult res = AllocationEngine::allocateSlot(1, city);
+                if (res.success) {
+                    int s = city.findSlotIndex(res.slotId);
+                    if (holders[s].fetch_add(1) != 0) doubleClaims++;
+                    held.push_back(s);
+                }
+                // Hold up to 25 slots per thread so the zone keeps running close to full
+                if (held.size() > 25 || (!res.success && !held.empty())) {
+                    int s = held.front();
+                    held.erase(held.begin());
+                    holders[s].fetch_sub(1);
+                    assert(city.releaseSlot(s));
+                }
+            }
+            for (int s : held) {
+                holders[s].fetch_sub(1);
+                city.releaseSlot(s);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    assert(doubleClaims == 0);
+    assert(zone.getOccupiedCount() == 0 && a1.getOccupiedCount() == 0 && a2.getOccupiedCount() == 0);
+    for (int s = 0; s < city.getSlotCount(); ++s) assert(!city.isOccupied(s));
+
+    // Turning the mode off rebuilds the free lists from the bitmap
+    city.occupySlot(3);
+    city.setLockFreeClaiming(false);
+    AllocationEngine::setStrategy(AllocationStrategy::FREE_LIST);
+    std::set<int> taken;
+    for (int i = 0; i < 159; ++i) taken.insert(AllocationEngine::allocateSlot(1, city).slotId);
+    assert(taken.size() == 159 && !taken.count(4) && !taken.count(-1));
+    assert(!AllocationEngine::allocateSlot(1, city).success);
+    AllocationEngine::setStrategy(AllocationStrategy::BITMAP);
+
+    // Same zone through ParkingSystem: every request gets its own slot
+    ParkingSystem ps = setupShardedCity(1, 200);
+    ps.enableLockFreeClaiming();
+    ps.setLogging(false);
+    threads.clear();
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&ps]() {
+            for (int i = 0; i < 50; ++i) ps.requestParking("L", 1);
+        });
+    }
+    for (auto& th : threads) th.join();
+    std::set<int> slots;
+    for (const auto& req : ps.getRequests()) slots.insert(req.getAssignedSlotId());
+    assert(slots.size() == 200 && !slots.count(-1));
+    std::cout << "Lock-free claiming OK\n";
+}
+
+void testCommandPipeline() {
+    ParkingSystem ps = setupShardedCity(2, 100);
+    ps.setLogging(false);
+    std::vector<std::future<int>> pending;
+    {
+        CommandPipeline pipeline(ps, 16); // Small ring so producers also hit the full case
+        std::vector<std::vector<int>> ids(4);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&pipeline, &ids, t]() {
+                std::vector<std::future<int>> futures;
+                for (int i = 0; i < 50; ++i) futures.push_back(pipeline.requestParking("P", t % 2 + 1));
+                for (auto& f : futures) ids[t].push_back(f.get());
+            });
+        }
+        for (auto& th : threads) th.join();
+
+        std::set<int> unique;
+        for (const auto& list : ids) unique.insert(list.begin(), list.end());
+        assert(unique.size() == 200);
+        for (Zone z : ps.getZones()) assert(z.isFull());
+
+        // One writer: requests are numbered and stored in execution order
+        const auto& reqs = ps.getRequests();
+        for (size_t i = 1; i < reqs.size(); ++i) assert(reqs[i].getRequestId() > reqs[i - 1].getRequestId());
+
+        pipeline.rollbackOperations(10).get(); // Undoes the 10 most recently executed allocations
+        for (size_t i = 0; i < reqs.size(); ++i) {
+            RequestState expected = i < 190 ? RequestState::ALLOCATED : RequestState::REQUESTED;
+            assert(reqs[i].getState() == expected);
+        }
+        assert(pipeline.leaveParking(reqs[0].getRequestId()).get() == 1);
+        assert(pipeline.cancelRequest(-5).get() == 0);
+        std::vector<int> batchIds = pipeline.requestParkingBatch({{"B1", 1}, {"B2", 2}, {"B3", 1}}).get();
+        assert(batchIds.size() == 3 && batchIds[0] > reqs[reqs.size() - 4].getRequestId());
+        assert(batchIds[1] == batchIds[0] + 1 && batchIds[2] == batchIds[0] + 2);
+        assert(reqs.back().getRequestId() == batchIds[2]);
+        assert(pipeline.getCommandsExecuted() == 204); // The batch is one command
+        assert(pipeline.getBatchesDrained() <= 204);
+
+        for (int i = 0; i < 5; ++i) pending.push_back(pipeline.requestParking("Late", 1));
+    } // Destructor runs everything already submitted
+    for (auto& f : pending) assert(f.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    std::cout << "Command pipeline OK\n";
+}
+
+// Every allocated request must point at an occupied slot, and the counts must add up
+void checkSnapshotConsistent(const StateSnapshot& snap) {
+    std::set<int> occupiedIds;
+    int zoneTotal = 0;
+    for (int z = 0; z < snap.getZoneCount(); ++z) {
+        zoneTotal += snap.getZoneOccupied(z);
+        for (int a = snap.getZoneAreaBegin(z); a < snap.getZoneAreaEnd(z); ++a) {
+            for (int s = snap.getAreaSlotBegin(a); s < snap.getAreaSlotEnd(a); ++s) {
+                if (snap.isOccupied(s)) occupiedIds.insert(snap.getSlotId(s));
+            }
+        }
+    }
+    int allocated = 0;
+    for (const auto& req : snap.getRequests()) {
+        if (req.getState() != RequestState::ALLOCATED) continue;
+        allocated++;
+        assert(occupiedIds.count(req.getAssignedSlotId()));
+    }
+    assert(allocated == (int)occupiedIds.size() && zoneTotal == allocated);
+}
+
+void testSnapshots() {
+    ParkingSystem ps = setupShardedCity(2, 70); // Zone 2 starts mid-word
+    ps.setLogging(false);
+
+    std::shared_ptr<const StateSnapshot> first = ps.getSnapshot();
+    assert(first->getVersion() == 1 && first->getZoneCount() == 2 && first->getSlotCount() == 140);
+    int r1 = ps.requestParking("S1", 2);
+    assert(ps.getSnapshot() == first); // Nothing published yet
+    ps.publishSnapshot();
+    std::shared_ptr<const StateSnapshot> second = ps.getSnapshot();
+    assert(second->getVersion() == 2 && second->getZoneOccupied(1) == 1 && second->getAreaOccupied(1) == 1);
+    assert(second->getRequests().size() == 1 && second->getMutationCount() == 1);
+    assert(first->getZoneOccupied(1) == 0 && first->getRequests().empty()); // Old snapshot is untouched
+
+    ps.setSnapshotOnCommit(true);
+    ps.leaveParking(r1);
+    assert(ps.getSnapshot()->getVersion() == 3 && ps.getSnapshot()->getZoneOccupied(1) == 0);
+    ps.setSnapshotOnCommit(false);
+
+    // Writers in both zones plus a rollback thread, interval publisher, and a reader checking every snapshot
+    std::atomic<bool> done(false);
+    std::atomic<int> snapshotsChecked(0);
+    {
+        SnapshotPublisher publisher(ps, 1);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; ++t) {
+            threads.emplace_back([&ps, t]() {
+                for (int i = 0; i < 2000; ++i) {
+                    int id = ps.requestParking("W", t + 1);
+                    if (i % 3 == 0) ps.cancelRequest(id);
+                    else if (i % 3 == 1) ps.leaveParking(id);
+                    if (i % 100 == 0) ps.rollbackOperations(2);
+                }
+            });
+        }
+        std::thread reader([&]() {
+            unsigned long lastVersion = 0;
+            do { // At least one check, even if the writers finish before this thread gets scheduled
+                std::shared_ptr<const StateSnapshot> snap = ps.getSnapshot();
+                assert(snap->getVersion() >= lastVersion);
+                lastVersion = snap->getVersion();
+                checkSnapshotConsistent(*snap);
+                snapshotsChecked++;
+                std::this_thread::yield();
+            } while (!done);
+        });
+        for (auto& th : threads) th.join();
+        done = true;
+        reader.join();
+    } // Publisher makes a final publish on the way out
+    assert(snapshotsChecked > 0);
+    assert(ps.getSnapshot()->getMutationCount() == ps.getMutationCount());
+    checkSnapshotConsistent(*ps.getSnapshot());
+    std::cout << "Snapshots OK\n";
+}
+
+void testRollbackHistory() {
+    RollbackManager history(4);
+    for (int i = 1; i <= 6; ++i) history.logOperation({Operation::ALLOCATE, i, i, 1, -1, -1});
+    assert(history.size() == 4 && history.getDroppedCount() == 2); // 1 and 2 evicted
+
+    RollbackView undone = history.rollback(3);
+    assert(undone.size() == 3 && undone[0].requestId == 6 && undone[2].requestId == 4); // Newest first
+    int expected = 6;
+    for (const Operation& op : undone) assert(op.requestId == expected--);
+    assert(history.rollback(5).size() == 1 && history.rollback(1).empty());
+
+    // Wrap around, then shrink: the newest survive
+    for (int i = 7; i <= 12; ++i) history.logOperation({Operation::CANCEL, i, i, 1, -1, -1});
+    history.setDepth(3);
+    assert(history.getDepth() == 3 && history.size() == 3 && history.getDroppedCount() == 5);
+    undone = history.rollback(3);
+    assert(undone[0].requestId == 12 && undone[2].requestId == 10);
+    history.logOperation({Operation::ALLOCATE, 13, 13, 1, -1, -1});
+    assert(history.rollback(2).size() == 1);
+
+    ParkingSystem ps = setupShardedCity(1, 10);
+    ps.setLogging(false);
+    ps.setRollbackDepth(2);
+    for (int i = 0; i < 3; ++i) ps.requestParking("H", 1);
+    assert(ps.getRollbackDropped() == 1);
+    ps.rollbackOperations(5); // Only the two remembered allocations can be undone
+    assert(ps.getZones()[0].getOccupiedCount() == 1);
+    assert(ps.getRequests()[0].getState() == RequestState::ALLOCATED);
+    std::cout << "Rollback history OK\n";
+}
+
+// A bad 10k-request import spread over several zones, undone in one call
+void testLargeRollback() {
+    const int zones = 8;
+    const int perZone = 1250;
+    ParkingSystem ps = setupShardedCity(zones, perZone);
+    ps.setLogging(false);
+    ps.setRollbackDepth(20000);
+
+    std::vector<ParkingRequestSpec> batch;
+    for (int i = 0; i < zones * perZone; ++i) batch.push_back({"IMP" + std::to_string(i), i % zones + 1});
+    std::vector<int> ids = ps.requestParkingBatch(batch);
+    for (int i = 0; i < 100; ++i) ps.cancelRequest(ids[i]);
+
+    ps.setLogging(true);
+    ps.rollbackOperations(100); // Undo the cancels: every slot is taken again
+    for (Zone z : ps.getZones()) assert(z.isFull());
+    ps.rollbackOperations(zones * perZone); // Then the whole import
+    ps.setLogging(false);
+    for (Zone z : ps.getZones()) assert(z.getOccupiedCount() == 0);
+    for (const auto& req : ps.getRequests()) assert(req.getState() == RequestState::REQUESTED && req.getAssignedSlotId() == -1);
+    std::cout << "Large rollback OK\n";
+}
+
+// Everything the log can restore: requests, occupancy and what rollback would undo next
+void checkSameState(ParkingSystem& a, ParkingSystem& b) {
+    const auto& ra = a.getRequests();
+    const auto& rb = b.getRequests();
+    assert(ra.size() == rb.size());
+    for (size_t i = 0; i < ra.size(); ++i) {
+        assert(ra[i].getRequestId() == rb[i].getRequestId());
+        assert(ra[i].getVehicleId() == rb[i].getVehicleId());
+        assert(ra[i].getState() == rb[i].getState());
+        assert(ra[i].getAssignedSlotId() == rb[i].getAssignedSlotId());
+    }
+    auto za = a.getZones();
+    auto zb = b.getZones();
+    for (auto ia = za.begin(), ib = zb.begin(); ia != za.end(); ++ia, ++ib) {
+        assert((*ia).getOccupiedCount() == (*ib).getOccupiedCount());
+    }
+}
+
+void copyFile(const std::string& from, const std::string& to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    out << in.rdbuf();
+}
+
+long fileSize(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return (long)in.tellg();
+}
+
+// Write that runs out of space after walWriteBudget bytes (unlimited while negative)
+std::atomic<long> walWriteBudget(-1);
+ssize_t budgetedWrite(int fd, const void* buf, size_t n) {
+    long budget = walWriteBudget.load();
+    if (budget < 0) return ::write(fd, buf, n);
+    if (budget == 0) {
+        errno = ENOSPC;
+        return -1;
+    }
+    ssize_t done = ::write(fd, buf, std::min(n, (size_t)budget));
+    if (done > 0) walWriteBudget -= done;
+    return done;
+}
+
+void testWriteAheadLog() {
+    const std::string path = "test_parking.wal";
+    const std::string crashed = "test_parking_crashed.wal";
+    std::remove(path.c_str());
+    std::remove(crashed.c_str());
+
+    ParkingSystem ps = setupShardedCity(2, 4);
+    ps.setLogging(false);
+    assert(ps.openWriteAheadLog(path, 4, 1));
+    int a = ps.requestParking("W1", 1);
+    int b = ps.requestParking("W2", 1);
+    ps.requestParkingBatch({{"W3", 2}, {"W4", 2}});
+    ps.leaveParking(a);
+    ps.cancelRequest(b);
+    ps.rollbackOperations(1); // Undoes the cancel of W2
+    ps.requestParking("W5", 2);
+    ps.syncWriteAheadLog();
+
+    // Simulated crash: take the durable file as it is now, plus half a record of garbage
+    copyFile(path, crashed);
+    long durable = fileSize(crashed);
+    {
+        std::ofstream out(crashed, std::ios::binary | std::ios::app);
+        const char torn[] = {0x30, 0, 0, 0, 1, 2, 3, 4, 't', 'o', 'r', 'n'}; // Header promises 48 bytes
+        out.write(torn, sizeof(torn));
+    }
+
+    ParkingSystem restored = setupShardedCity(2, 4);
+    restored.setLogging(false);
+    assert(restored.openWriteAheadLog(crashed, 4, 1));
+    assert(fileSize(crashed) == durable); // Torn tail cut off before appending
+    assert(restored.getRequests().size() == 5);
+    assert(restored.getRequests()[1].getState() == RequestState::ALLOCATED);
+    checkSameState(ps, restored);
+
+    // The rollback history survived too: both undo W5 and W4
+    ps.rollbackOperations(2);
+    restored.rollbackOperations(2);
+    checkSameState(ps, restored);
+    assert(restored.getRequests()[3].getState() == RequestState::REQUESTED);
+
+    // New IDs continue past the recovered ones
+    int next = restored.requestParking("W6", 1);
+    assert(next > restored.getRequests()[4].getRequestId());
+    restored.syncWriteAheadLog();
+
+    // And the restored system's own log replays again
+    ParkingSystem again = setupShardedCity(2, 4);
+    again.setLogging(false);
+    copyFile(crashed, path + ".2");
+    assert(again.openWriteAheadLog(path + ".2", 4, 1));
+    checkSameState(restored, again);
+
+    // A rollback is one record: a crash that tears it keeps neither the pop nor the reverted requests
+    ParkingSystem beforeUndo = setupShardedCity(2, 4);
+    beforeUndo.setLogging(false);
+    copyFile(crashed, path + ".3");
+    assert(beforeUndo.openWriteAheadLog(path + ".3", 4, 1));
+    restored.rollbackOperations(2);
+    restored.syncWriteAheadLog();
+    {
+        std::ifstream in(crashed, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(path + ".4", std::ios::binary);
+        out.write(bytes.data(), (std::streamsize)bytes.size() - 3); // Torn inside the rollback record
+    }
+    ParkingSystem tornUndo = setupShardedCity(2, 4);
+    tornUndo.setLogging(false);
+    assert(tornUndo.openWriteAheadLog(path + ".4", 4, 1));
+    checkSameState(beforeUndo, tornUndo);
+    beforeUndo.rollbackOperations(2);
+    tornUndo.rollbackOperations(2); // The history is intact, so the same undo can be retried
+    checkSameState(restored, tornUndo);
+    checkSameState(beforeUndo, tornUndo);
+
+    // A failed write is reported by sync() and cut off the file; the batch goes out once writes work again
+    {
+        WriteAheadLog log;
+        assert(log.open(path + ".5", 0, 1000, 1000));
+        log.appendSegmentHeader(1);
+        assert(log.sync());
+        long good = fileSize(path + ".5");
+        log.setWriteFunction(budgetedWrite);
+        walWriteBudget = 100; // Room for about two of the ten records, then ENOSPC
+        for (int i = 0; i < 10; ++i) log.appendRequest(ParkingRequest(900 + i, "FAILED-WRITE", 1, 0, false));
+        assert(!log.sync());
+        assert(log.getWriteFailures() >= 1 && fileSize(path + ".5") == good);
+        walWriteBudget = -1;
+        assert(log.sync());
+        log.close();
+
+        WalReader reader(path + ".5");
+        WalRecord rec;
+        int records = 0;
+        while (reader.next(rec)) records++;
+        assert(records == 11 && reader.getValidLength() == fileSize(path + ".5"));
+    }
+
+    std::remove(path.c_str());
+    std::remove(crashed.c_str());
+    std::remove((path + ".2").c_str());
+    std::remove((path + ".3").c_str());
+    std::remove((path + ".4").c_str());
+    std::remove((path + ".5").c_str());
+    std::cout << "Write-ahead log OK\n";
+}
+
+bool fileExists(const std::string& path) {
+    return std::ifstream(path).good();
+}
+
+void testCheckpoint() {
+    const std::string wal = "test_ckpt.wal";
+    const std::string image = "test_ckpt.img";
+    const std::string crashedWal = "test_ckpt_crashed.wal";
+    const std::string crashedImage = "test_ckpt_crashed.img";
+    for (const std::string& f : {wal, image, crashedWal, crashedImage}) std::remove(f.c_str());
+
+    ParkingSystem ps = setupShardedCity(3, 50);
+    ps.getZones()[0].addAdjacentZone(2);
+    ps.setLogging(false);
+    assert(ps.openWriteAheadLog(wal, 16, 1));
+    std::vector<ParkingRequestSpec> batch;
+    for (int i = 0; i < 120; ++i) batch.push_back({"C" + std::to_string(i), i % 3 + 1});
+    std::vector<int> ids = ps.requestParkingBatch(batch);
+    for (int i = 0; i < 10; ++i) ps.cancelRequest(ids[i]);
+    ps.rollbackOperations(3);
+
+    assert(ps.writeCheckpoint(image));
+    assert(!fileExists(wal + ".0")); // The segment the image covers is gone
+    long segmentBytes = fileSize(wal);
+
+    // Tail after the checkpoint: touches requests from the image and adds new ones
+    ps.leaveParking(ids[50]);
+    ps.cancelRequest(ids[51]);
+    int late = ps.requestParking("LATE", 2);
+    ps.rollbackOperations(1); // Undoes LATE's allocation
+    ps.syncWriteAheadLog();
+    assert(fileSize(wal) > segmentBytes);
+
+    // Crash: restart from the image plus the log tail
+    copyFile(image, crashedImage);
+    copyFile(wal, crashedWal);
+    ParkingSystem restored;
+    restored.setLogging(false);
+    assert(restored.loadCheckpoint(crashedImage));
+    assert(restored.openWriteAheadLog(crashedWal, 16, 1));
+    checkSameState(ps, restored);
+    assert(restored.getZones()[0].getAdjacentZones().size() == 1);
+    assert(restored.getRollbackDropped() == ps.getRollbackDropped());
+
+    // Rollback history spans image and tail
+    ps.rollbackOperations(20);
+    restored.rollbackOperations(20);
+    checkSameState(ps, restored);
+
+    // A second checkpoint on the restored system, then restart from that image alone
+    assert(restored.writeCheckpoint(crashedImage));
+    ParkingSystem again;
+    again.setLogging(false);
+    assert(again.loadCheckpoint(crashedImage));
+    assert(again.openWriteAheadLog(crashedWal, 16, 1));
+    checkSameState(restored, again);
+    assert(again.requestParking("NEXT", 3) > late); // IDs continue past everything restored
+
+    // The image write fails after the log was rotated: the older image plus both segments still recover
+    const std::string chainWal = "test_ckpt_chain.wal";
+    assert(!ps.writeCheckpoint("no_such_dir/test_ckpt.img"));
+    assert(fileExists(wal + ".1"));
+    ps.requestParking("CHAIN", 1);
+    ps.syncWriteAheadLog();
+    copyFile(wal + ".1", chainWal + ".1");
+    copyFile(wal, chainWal);
+    ParkingSystem chained;
+    chained.setLogging(false);
+    assert(chained.loadCheckpoint(image));
+    assert(chained.openWriteAheadLog(chainWal, 16, 1));
+    checkSameState(ps, chained);
+
+    // The next successful checkpoint deletes every segment it covers
+    assert(ps.writeCheckpoint(image));
+    assert(!fileExists(wal + ".1") && !fileExists(wal + ".2"));
+
+    // A corrupt image is refused, so the caller falls back to assembling the city
+    {
+        std::fstream f(crashedImage, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(fileSize(crashedImage) / 2);
+        f.put('\x7f');
+    }
+    ParkingSystem corrupt;
+    corrupt.setLogging(false);
+    assert(!corrupt.loadCheckpoint(crashedImage));
+    assert(corrupt.getZones().empty());
+
+    // Checkpoints cut from a background thread while two threads keep parking
+    const std::string liveWal = "test_ckpt_live.wal";
+    const std::string liveImage = "test_ckpt_live.img";
+    {
+        ParkingSystem live = setupShardedCity(2, 50);
+        live.setLogging(false);
+        assert(live.openWriteAheadLog(liveWal, 16, 1));
+        {
+            Checkpointer checkpointer(live, liveImage, 1);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 2; ++t) {
+                threads.emplace_back([&live, t]() {
+                    for (int i = 0; i < 300; ++i) {
+                        int id = live.requestParking("L", t + 1);
+                        if (i % 3) live.leaveParking(id);
+                    }
+                });
+            }
+            for (auto& th : threads) th.join();
+        }
+        live.syncWriteAheadLog();
+        ParkingSystem recovered;
+        recovered.setLogging(false);
+        assert(recovered.loadCheckpoint(liveImage));
+        copyFile(liveWal, liveWal + ".copy");
+        assert(recovered.openWriteAheadLog(liveWal + ".copy", 16, 1));
+        checkSameState(live, recovered);
+    }
+
+    for (const std::string& f : {wal, image, crashedWal, crashedImage, chainWal, chainWal + ".1", liveWal, liveImage, liveWal + ".copy"}) {
+        std::remove(f.c_str());
+    }
+    std::cout << "Checkpoint OK\n";
+}
+
+void testForkBackup() {
+    const std::string backup = "test_backup.img";
+    std::remove(backup.c_str());
+    ParkingSystem ps = setupShardedCity(2, 200);
+    ps.setLogging(false);
+    ps.enableConcurrency();
+    for (int i = 0; i < 100; ++i) ps.requestParking("F", i % 2 + 1);
+
+    // Writers keep going while the child writes; the image must still be one consistent moment
+    std::atomic<bool> stop(false);
+    std::thread writer([&]() {
+        while (!stop) ps.leaveParking(ps.requestParking("G", 1));
+    });
+    BackupStats stats;
+    assert(ps.forkBackup(backup, stats));
+    stop = true;
+    writer.join();
+    assert(stats.imageBytes > 0 && stats.pauseMs <= stats.totalMs);
+
+    ParkingSystem restored;
+    restored.setLogging(false);
+    assert(restored.loadCheckpoint(backup));
+    int active = 0;
+    for (const auto& req : restored.getRequests()) {
+        if (req.getState() == RequestState::ALLOCATED || req.getState() == RequestState::OCCUPIED) active++;
+    }
+    int occupied = 0;
+    for (Zone z : restored.getZones()) occupied += z.getOccupiedCount();
+    assert(occupied == active && active >= 100);
+
+    // Quiescent backup matches the live system exactly
+    assert(ps.forkBackup(backup, stats));
+    ParkingSystem exact;
+    exact.setLogging(false);
+    assert(exact.loadCheckpoint(backup));
+    checkSameState(ps, exact);
+
+    // Concurrent backups: each one either completes or is refused as busy, never fails
+    std::atomic<int> written(0);
+    std::vector<std::thread> backups;
+    for (int t = 0; t < 4; ++t) {
+        backups.emplace_back([&]() {
+            BackupStats s;
+            if (ps.forkBackup(backup, s)) written++;
+            else assert(s.busy);
+        });
+    }
+    for (auto& th : backups) th.join();
+    assert(written >= 1);
+    ParkingSystem last;
+    last.setLogging(false);
+    assert(last.loadCheckpoint(backup));
+    std::remove(backup.c_str());
+    std::cout << "Fork backup OK\n";
+}
+
+void testDeltaSync() {
+    ParkingSystem ps = setupShardedCity(2, 100);
+    ps.setLogging(false);
+    ps.setSnapshotOnCommit(true);
+    std::vector<int> ids;
+    for (int i = 0; i < 20; ++i) ids.push_back(ps.requestParking("D", i % 2 + 1));
+    std::shared_ptr<const StateSnapshot> before = ps.getSnapshot();
+
+    ps.leaveParking(ids[3]);
+    ps.cancelRequest(ids[4]);
+    int fresh = ps.requestParking("NEW", 2);
+    ps.rollbackOperations(1); // Undoes NEW again: its slot ends where it started
+    std::shared_ptr<const StateSnapshot> after = ps.getSnapshot();
+
+    // Applying the delta to the old snapshot reproduces the new one
+    std::vector<int> slots;
+    std::vector<int> changed;
+    assert(ps.getChangesSince(before->getVersion(), *after, slots, changed));
+    assert(slots.size() == 2 && changed.size() == 3); // ids[3], ids[4] and NEW, which took ids[3]'s slot and gave it back
+    std::vector<bool> occupied(after->getSlotCount());
+    for (int s = 0; s < after->getSlotCount(); ++s) occupied[s] = before->isOccupied(s);
+    for (int s : slots) occupied[s] = after->isOccupied(s);
+    for (int s = 0; s < after->getSlotCount(); ++s) assert(occupied[s] == after->isOccupied(s));
+    assert(after->getRequests()[changed.back()].getRequestId() == fresh);
+    for (size_t pos = 0; pos < before->getRequests().size(); ++pos) {
+        bool listed = std::find(changed.begin(), changed.end(), (int)pos) != changed.end();
+        assert(listed || before->getRequests()[pos].getState() == after->getRequests()[pos].getState());
+    }
+
+    // Up to date: empty delta. Never synced, from the future, or across a structural change: resync
+    assert(ps.getChangesSince(after->getVersion(), *after, slots, changed) && slots.empty() && changed.empty());
+    assert(!ps.getChangesSince(0, *after, slots, changed));
+    assert(!ps.getChangesSince(after->getVersion() + 1, *after, slots, changed));
+    ps.addZone(3).addParkingArea(3).addSlot(999);
+    ps.requestParking("GROW", 3);
+    assert(!ps.getChangesSince(after->getVersion(), *ps.getSnapshot(), slots, changed));
+
+    // A burst larger than the retained history forces a resync too
+    std::shared_ptr<const StateSnapshot> pre = ps.getSnapshot();
+    std::vector<ParkingRequestSpec> burst(ChangeLog::DEFAULT_CAPACITY, {"B", 1});
+    ps.requestParkingBatch(burst);
+    assert(!ps.getChangesSince(pre->getVersion(), *ps.getSnapshot(), slots, changed));
+    std::cout << "Delta sync OK\n";
+}
+
+void testDataJsonCache() {
+    ParkingSystem ps = setupShardedCity(4, 50);
+    ps.setLogging(false);
+    ps.setSnapshotOnCommit(true);
+    for (int i = 0; i < 40; ++i) ps.requestParking("J", i % 4 + 1);
+    DataJsonCache cache(7);
+    std::string etag;
+    std::shared_ptr<const std::string> first = cache.get(ps, *ps.getSnapshot(), etag);
+    assert(cache.getZoneRenders() == 4 && cache.getRequestRenders() == 40);
+
+    // Nothing changed: the same document, nothing rendered
+    std::string sameTag;
+    assert(cache.get(ps, *ps.getSnapshot(), sameTag) == first && sameTag == etag);
+    assert(cache.getZoneRenders() == 4 && cache.getRequestRenders() == 40);
+
+    // One allocation in zone 3 re-renders that zone and the new request only
+    ps.requestParking("K", 3);
+    std::string nextTag;
+    std::shared_ptr<const std::string> next = cache.get(ps, *ps.getSnapshot(), nextTag);
+    assert(nextTag != etag && *next != *first);
+    assert(cache.getZoneRenders() == 5 && cache.getRequestRenders() == 41);
+
+    // Leave and rollback touch zones 1 and 2 and two old requests
+    ps.leaveParking(ps.getRequests()[0].getRequestId());
+    ps.cancelRequest(ps.getRequests()[1].getRequestId());
+    ps.rollbackOperations(1);
+    next = cache.get(ps, *ps.getSnapshot(), nextTag);
+    assert(cache.getZoneRenders() == 7 && cache.getRequestRenders() == 43);
+
+    // Identical to rendering from scratch
+    DataJsonCache fresh(7);
+    std::string freshTag;
+    assert(*fresh.get(ps, *ps.getSnapshot(), freshTag) == *next && freshTag == nextTag);
+
+    // Streaming the same snapshot in small chunks gives the same bytes
+    DataJsonStream stream(ps.getSnapshot(), 7);
+    std::string streamed;
+    size_t chunks = 0;
+    while (stream.next(64)) {
+        assert(stream.chunk().size() < 64 + 128); // One slot or request past the chunk size at most
+        streamed.append(stream.chunk().data(), stream.chunk().size());
+        chunks++;
+    }
+    assert(streamed == *next && chunks > next->size() / 192);
+    assert(dataJsonEtag(7, ps.getSnapshot()->getVersion()) == nextTag);
+
+    // A structural change renders everything again
+    ps.addZone(5).addParkingArea(5).addSlot(999);
+    ps.requestParking("GROW", 5);
+    cache.get(ps, *ps.getSnapshot(), nextTag);
+    assert(cache.getZoneRenders() == 12);
+    std::cout << "Data JSON cache OK\n";
+}
+
+// Simulated wall clock for time-dependent tests (ParkingSystem::setClock)
+time_t simulatedNow = 1700000000;
+time_t simulatedClock() {
+    return simulatedNow;
+}
+
+// All pages of `query`, checked against a scan of the whole table
+void checkRequestQuery(ParkingSystem& ps, RequestQuery query) {
+    std::vector<int> expected;
+    for (const ParkingRequest& r : ps.getRequests()) {
+        bool stateOk = query.states.empty() || std::find(query.states.begin(), query.states.end(), r.getState()) != query.states.end();
+        if (stateOk && (query.requestedZoneId == -1 || r.getRequestedZoneId() == query.requestedZoneId) &&
+            (query.assignedZoneId == -1 || r.getAssignedZoneId() == query.assignedZoneId) &&
+            (query.vehicleId.empty() || r.getVehicleId() == query.vehicleId) &&
+            (query.from == 0 || r.getRequestTime() >= query.from) && (query.to == 0 || r.getRequestTime() <= query.to)) {
+            expected.push_back(r.getRequestId());
+        }
+    }
+    std::vector<int> got;
+    std::vector<ParkingRequest> page;
+    int next = -1;
+    query.limit = 7;
+    do {
+        query.afterRequestId = next;
+        assert(ps.queryRequests(query, page, next));
+        assert(page.size() <= 7);
+        for (const ParkingRequest& r : page) got.push_back(r.getRequestId());
+    } while (next != -1);
+    assert(got == expected);
+}
+
+void checkRequestQueries(ParkingSystem& ps) {
+    RequestQuery active;
+    active.states = {RequestState::REQUESTED, RequestState::ALLOCATED, RequestState::OCCUPIED};
+    checkRequestQuery(ps, active);
+    for (int z = 1; z <= 3; ++z) {
+        RequestQuery zone;
+        zone.requestedZoneId = z;
+        checkRequestQuery(ps, zone);
+        zone.states = {RequestState::CANCELLED};
+        checkRequestQuery(ps, zone);
+        RequestQuery assigned;
+        assigned.assignedZoneId = z;
+        checkRequestQuery(ps, assigned);
+    }
+    RequestQuery vehicle;
+    vehicle.vehicleId = "Q3";
+    checkRequestQuery(ps, vehicle);
+    RequestQuery range;
+    range.from = ps.getRequests().front().getRequestTime();
+    range.to = ps.getRequests().back().getRequestTime();
+    range.states = {RequestState::RELEASED};
+    checkRequestQuery(ps, range);
+    checkRequestQuery(ps, RequestQuery());
+}
+
+void testRequestQueries() {
+    const std::string wal = "test_query.wal";
+    std::remove(wal.c_str());
+    {
+        ParkingSystem ps = setupShardedCity(3, 10);
+        ps.setLogging(false);
+        assert(ps.openWriteAheadLog(wal, 16, 1));
+        std::vector<int> ids;
+        for (int i = 0; i < 45; ++i) ids.push_back(ps.requestParking("Q" + std::to_string(i % 7), i % 3 + 1)); // Some find no slot
+        for (int i = 0; i < 45; i += 4) ps.leaveParking(ids[i]);
+        for (int i = 1; i < 45; i += 5) ps.cancelRequest(ids[i]);
+        ps.rollbackOperations(6); // Brings cancelled requests back and un-allocates recent ones
+        for (int i = 0; i < 10; ++i) ps.requestParking("Q" + std::to_string(i), 2);
+        checkRequestQueries(ps);
+
+        std::vector<ParkingRequest> page;
+        int next;
+        RequestQuery bad;
+        bad.afterRequestId = -42;
+        assert(!ps.queryRequests(bad, page, next));
+        RequestQuery none;
+        none.vehicleId = "nobody";
+        assert(ps.queryRequests(none, page, next) && page.empty() && next == -1);
+    }
+
+    // Indexes are rebuilt from what the log replays
+    ParkingSystem ps = setupShardedCity(3, 10);
+    ps.setLogging(false);
+    assert(ps.openWriteAheadLog(wal, 16, 1));
+    checkRequestQueries(ps);
+    std::remove(wal.c_str());
+
+    // Concurrent stores can land out of creation-time order; time ranges must still find every row
+    ParkingSystem shuffled = setupShardedCity(2, 20);
+    shuffled.setLogging(false);
+    shuffled.setClock(simulatedClock);
+    const time_t base = 1700000000;
+    const int offsets[] = {0, 10, 5, 20, 3, 30, 30, 25, 40, 1};
+    for (int i = 0; i < 30; ++i) {
+        simulatedNow = base + offsets[i % 10] + 40 * (i / 10);
+        shuffled.requestParking("T" + std::to_string(i % 4), i % 2 + 1);
+    }
+    for (time_t from : {base, base + 4, base + 21, base + 45}) {
+        for (time_t to : {base + 2, base + 5, base + 26, base + 80, base + 200}) {
+            RequestQuery range;
+            range.from = from;
+            range.to = to;
+            checkRequestQuery(shuffled, range);
+            range.from = 0;
+            checkRequestQuery(shuffled, range);
+            range.vehicleId = "T1";
+            checkRequestQuery(shuffled, range);
+            range.vehicleId.clear();
+            range.states = {RequestState::ALLOCATED};
+            checkRequestQuery(shuffled, range);
+        }
+    }
+    std::cout << "Request queries OK\n";
+}
+
+void sameRequest(const ParkingRequest& a, const ParkingRequest& b) {
+    assert(a.getRequestId() == b.getRequestId() && a.getVehicleId() == b.getVehicleId());
+    assert(a.getRequestedZoneId() == b.getRequestedZoneId() && a.getAssignedSlotId() == b.getAssignedSlotId());
+    assert(a.getAssignedZoneId() == b.getAssignedZoneId() && a.getState() == b.getState());
+    assert(a.getRequestTime() == b.getRequestTime() && a.getEndTime() == b.getEndTime());
+}
+
+// Every request ID after `afterId` (-1 for all), paging three at a time
+std::vector<int> pageAllRequests(ParkingSystem& ps, int afterId) {
+    std::vector<int> ids;
+    std::vector<ParkingRequest> page;
+    RequestQuery query;
+    query.limit = 3;
+    int next = afterId;
+    do {
+        query.afterRequestId = next;
+        bool ok = ps.queryRequests(query, page, next);
+        assert(ok);
+        for (const ParkingRequest& r : page) ids.push_back(r.getRequestId());
+    } while (next != -1);
+    return ids;
+}
+
+void testArchive() {
+    const std::string image = "test_archive.img";
+    std::remove(image.c_str());
+    ParkingSystem ps = setupShardedCity(2, 20);
+    ps.setLogging(false);
+    ps.setClock(simulatedClock);
+    ps.setSnapshotOnCommit(true);
+    ps.setRollbackDepth(4);
+    RetentionPolicy retention;
+    retention.hotSeconds = 3600;
+    retention.archiveSeconds = 3 * 86400;
+    ps.setRetention(retention);
+
+    std::vector<int> ids;
+    for (int i = 0; i < 30; ++i) ids.push_back(ps.requestParking("ARCH-" + std::to_string(i), i % 2 + 1));
+    for (int i = 0; i < 10; ++i) ps.leaveParking(ids[i]);
+    for (int i = 10; i < 15; ++i) ps.cancelRequest(ids[i]);
+    simulatedNow += 1800;
+    ps.leaveParking(ids[15]); // Finished too recently
+    assert(ps.archiveRequests() == 0);
+
+    // An hour later: everything finished before the cutoff moves, except what the history can undo
+    simulatedNow += 1801;
+    std::vector<ParkingRequest> before = ps.getRequests();
+    std::shared_ptr<const StateSnapshot> snap = ps.getSnapshot();
+    std::vector<ParkingRequest> firstPage;
+    RequestQuery paging;
+    paging.limit = 5;
+    int cursor;
+    assert(ps.queryRequests(paging, firstPage, cursor) && cursor == ids[4]);
+    assert(ps.archiveRequests() == 11); // ids[0..14] minus the 4 cancellations still in the history
+    assert(ps.getRequests().size() == 19 && ps.getArchive().getRecordCount() == 11);
+    std::vector<ParkingRequest> cold;
+    ps.getArchive().scan([&](const ParkingRequest& r) { cold.push_back(r); });
+    size_t hot = 0, c = 0;
+    for (const ParkingRequest& r : before) {
+        if (hot < ps.getRequests().size() && ps.getRequests()[hot].getRequestId() == r.getRequestId()) sameRequest(ps.getRequests()[hot++], r);
+        else sameRequest(cold[c++], r);
+    }
+    assert(hot == 19 && c == 11);
+    std::vector<int> slots, changed;
+    assert(!ps.getChangesSince(snap->getVersion(), *ps.getSnapshot(), slots, changed)); // Positions moved
+
+    // A cursor naming an archived request resumes where it was
+    std::vector<int> hotIds;
+    for (const ParkingRequest& r : ps.getRequests()) hotIds.push_back(r.getRequestId());
+    assert(pageAllRequests(ps, cursor) == hotIds);
+    assert(pageAllRequests(ps, ids[7]) == hotIds);
+    assert(pageAllRequests(ps, ids[12]) == std::vector<int>(hotIds.begin() + 2, hotIds.end()));
+
+    // The compacted table keeps working: lookups, rollback handles and indexes
+    assert(!ps.leaveParking(ids[0])); // Archived
+    assert(ps.leaveParking(ids[20]));
+    ps.rollbackOperations(3); // Undoes the cancellations of ids[14], ids[13] and ids[12]
+    assert(ps.getRequests()[1].getRequestId() == ids[12] && ps.getRequests()[1].getState() == RequestState::ALLOCATED);
+    checkRequestQuery(ps, RequestQuery());
+    RequestQuery active;
+    active.states = {RequestState::ALLOCATED};
+    checkRequestQuery(ps, active);
+
+    // The archive travels with checkpoints
+    assert(ps.writeCheckpoint(image));
+    ParkingSystem restored;
+    restored.setLogging(false);
+    assert(restored.loadCheckpoint(image));
+    checkSameState(ps, restored);
+    std::vector<ParkingRequest> restoredCold;
+    restored.getArchive().scan([&](const ParkingRequest& r) { restoredCold.push_back(r); });
+    assert(restoredCold.size() == cold.size());
+    for (size_t i = 0; i < cold.size(); ++i) sameRequest(restoredCold[i], cold[i]);
+
+    // Retention drops whole blocks once everything in them is old enough
+    std::vector<ParkingRequestSpec> burst(ColdArchive::BLOCK_RECORDS, {"BURST", 1});
+    for (int id : ps.requestParkingBatch(burst)) ps.cancelRequest(id); // Mostly unallocated: the city is full
+    simulatedNow += 2 * 3600;
+    std::vector<int> beforePass = pageAllRequests(ps, -1);
+    ps.archiveRequests();
+    // Cursors from before this pass, archived in it or in the first one, still resume in order
+    std::vector<int> afterPass = pageAllRequests(ps, -1);
+    for (int after : {ids[4], ids[20], beforePass[beforePass.size() / 2]}) {
+        auto at = std::find(beforePass.begin(), beforePass.end(), after);
+        std::vector<int> expected;
+        for (int id : afterPass) {
+            if (at == beforePass.end() || std::find(at + 1, beforePass.end(), id) != beforePass.end()) expected.push_back(id);
+        }
+        assert(pageAllRequests(ps, after) == expected);
+    }
+    size_t archivedNow = ps.getArchive().getRecordCount();
+    assert(archivedNow > ColdArchive::BLOCK_RECORDS); // The first block is full
+    simulatedNow += 3 * 86400;
+    ps.archiveRequests();
+    assert(ps.getArchive().getRecordCount() == archivedNow - ColdArchive::BLOCK_RECORDS);
+    assert(ps.getArchive().getDroppedCount() == ColdArchive::BLOCK_RECORDS);
+    std::remove(image.c_str());
+    std::cout << "Archive OK\n";
+}
+
+void testJsonWriter() {
+    JsonWriter json;
+    json.raw("{ ").key("v").string("a\"b\\c\nd\x01").raw(", ").key("n").number(-42).raw(", ").key("d").number(2.5)
+        .raw(", ").key("z").number(0.0).raw(", ").key("b").boolean(true).raw(" }");
+    assert(json.str() == "{ \"v\": \"a\\\"b\\\\c\\nd\\u0001\", \"n\": -42, \"d\": 2.5, \"z\": 0, \"b\": true }");
+
+    // Reuse keeps the buffer
+    size_t capacity = json.str().capacity();
+    json.clear();
+    json.number(7UL);
+    assert(json.str() == "7" && json.str().capacity() == capacity);
+    std::cout << "JSON writer OK\n";
+}
+
+void testEventHub() {
+    ParkingSystem ps = setupShardedCity(2, 10);
+    ps.setLogging(false);
+    std::shared_ptr<EventHub> hub = std::make_shared<EventHub>();
+    ps.setEventHub(hub);
+    std::shared_ptr<EventSubscription> sub = hub->subscribe(1024);
+
+    int a = ps.requestParking("E1", 1);
+    int b = ps.requestParking("E2", 2);
+    ps.cancelRequest(a);
+    ps.leaveParking(b);
+    ps.rollbackOperations(1); // Undoes the cancel of E1
+
+    std::vector<std::shared_ptr<const ParkingEvent>> events;
+    assert(hub->wait(*sub, events, 0) == EventHub::EVENTS && events.size() == 5);
+    const char* types[] = {"allocate", "allocate", "cancel", "leave", "rollback"};
+    for (size_t i = 0; i < events.size(); ++i) {
+        assert(std::string(events[i]->type) == types[i]);
+        assert(i == 0 || events[i]->sequence == events[i - 1]->sequence + 1);
+    }
+    assert(events[3]->request.getState() == RequestState::RELEASED);
+    assert(events[4]->request.getRequestId() == a && events[4]->request.getState() == RequestState::ALLOCATED);
+    assert(hub->wait(*sub, events, 1) == EventHub::TIMEOUT);
+
+    // A subscriber that stops reading is cut loose, the writer never waits for it
+    std::shared_ptr<EventSubscription> slow = hub->subscribe(4);
+    std::thread consumer([&]() {
+        int seen = 0;
+        while (seen < 200) {
+            assert(hub->wait(*sub, events, 1000) == EventHub::EVENTS);
+            seen += (int)events.size();
+        }
+    });
+    for (int i = 0; i < 100; ++i) ps.leaveParking(ps.requestParking("E", 1));
+    consumer.join();
+    assert(hub->wait(*slow, events, 0) == EventHub::RESYNC && hub->getResyncCount() == 1);
+    ps.requestParking("AFTER", 2);
+    assert(hub->wait(*slow, events, 0) == EventHub::EVENTS && events.size() == 1); // Back in sync
+
+    hub->unsubscribe(slow);
+    assert(hub->getSubscriberCount() == 1);
+    hub->close();
+    assert(hub->wait(*sub, events, 1000) == EventHub::CLOSED);
+
+    // The cap holds however many subscribe at once
+    EventHub capped(3);
+    std::atomic<int> admitted(0);
+    std::vector<std::thread> subscribers;
+    for (int t = 0; t < 8; ++t) {
+        subscribers.emplace_back([&]() {
+            if (capped.subscribe(16)) admitted++;
+        });
+    }
+    for (auto& th : subscribers) th.join();
+    assert(admitted == 3 && capped.getSubscriberCount() == 3);
+    std::cout << "Event hub OK\n";
+}
+
+// Allocate+release pairs in one 100k-slot zone pre-filled (first-fit, like real traffic) to a given level
+void benchmarkStrategies() {
+    const int slotCount = 100000;
+    const int iterations = 2000;
+    const AllocationStrategy strategies[] = {AllocationStrategy::LINEAR_SCAN, AllocationStrategy::BITMAP, AllocationStrategy::FREE_LIST};
+    const int fillPercents[] = {10, 50, 99};
+
+    std::cout << "\n--- Allocation benchmark (" << slotCount << " slots, " << iterations << " allocate/release pairs) ---\n";
+    for (int fill : fillPercents) {
+        for (AllocationStrategy strategy : strategies) {
+            CityLayout city;
+            Zone zone(&city, city.addZone(1));
+            ParkingArea area = zone.addParkingArea(1);
+            for (int i = 0; i < slotCount; ++i) area.addSlot(i + 1);
+
+            for (int i = 0; i < slotCount * fill / 100; ++i) city.occupySlot(i);
+
+            AllocationEngine::setStrategy(strategy);
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                AllocationResult res = AllocationEngine::allocateSlot(1, city);
+                city.releaseSlot(city.findSlotIndex(res.slotId));
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  " << fill << "% full, " << strategyName(strategy) << ": " << (double)ns / iterations << " ns/op\n";
+        }
+    }
+    AllocationEngine::setStrategy(AllocationStrategy::BITMAP);
+}
+
+// Threads each park and release in their own zone: zone-sharded locking vs one global mutex
+void benchmarkConcurrency() {
+    const int slotsPerZone = 1000;
+    const int opsPerThread = 20000;
+    const int threadCounts[] = {1, 2, 4, 8};
+
+    std::cout << "\n--- Concurrent throughput (" << opsPerThread << " park/leave pairs per thread, one zone each, "
+              << std::thread::hardware_concurrency() << " hardware threads) ---\n";
+    for (int threadCount : threadCounts) {
+        for (int sharded = 0; sharded < 2; ++sharded) {
+            ParkingSystem ps = setupShardedCity(threadCount, slotsPerZone);
+            ps.setLogging(false);
+            if (sharded) ps.enableConcurrency();
+            std::mutex globalLock;
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t]() {
+                    for (int i = 0; i < opsPerThread; ++i) {
+                        if (sharded) {
+                            ps.leaveParking(ps.requestParking("V", t + 1));
+                        } else {
+                            std::lock_guard<std::mutex> lock(globalLock);
+                            ps.leaveParking(ps.requestParking("V", t + 1));
+                        }
+                    }
+                });
+            }
+            for (auto& th : threads) th.join();
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  " << threadCount << " threads, " << (sharded ? "zone locks  " : "global mutex") << ": "
+                      << (long)(threadCount * opsPerThread / secs) << " pairs/s\n";
+        }
+    }
+
+    std::cout << "--- Same busy zone (" << opsPerThread << " park/leave pairs per thread) ---\n";
+    for (int threadCount : threadCounts) {
+        for (int lockFree = 0; lockFree < 2; ++lockFree) {
+            ParkingSystem ps = setupShardedCity(1, slotsPerZone);
+            ps.setLogging(false);
+            if (lockFree) ps.enableLockFreeClaiming(); else ps.enableConcurrency();
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&ps]() {
+                    for (int i = 0; i < opsPerThread; ++i) ps.leaveParking(ps.requestParking("V", 1));
+                });
+            }
+            for (auto& th : threads) th.join();
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  " << threadCount << " threads, " << (lockFree ? "lock-free" : "zone lock") << ": "
+                      << (long)(threadCount * opsPerThread / secs) << " pairs/s\n";
+        }
+    }
+}
+
+// Callers park and immediately leave, each call timed: one writer thread vs callers taking a global mutex
+void benchmarkPipeline() {
+    const int pairsPerThread = 5000;
+    const int threadCounts[] = {1, 2, 4, 8};
+
+    std::cout << "--- Single-writer pipeline vs global mutex (" << pairsPerThread << " park/leave pairs per thread) ---\n";
+    for (int threadCount : threadCounts) {
+        for (int piped = 0; piped < 2; ++piped) {
+            ParkingSystem ps = setupShardedCity(threadCount, 1000);
+            ps.setLogging(false);
+            std::mutex globalLock;
+            std::unique_ptr<CommandPipeline> pipeline;
+            if (piped) pipeline.reset(new CommandPipeline(ps, 1024, 0));
+
+            std::vector<std::vector<long>> latencies(threadCount);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t]() {
+                    latencies[t].reserve(2 * pairsPerThread);
+                    for (int i = 0; i < pairsPerThread; ++i) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        int id;
+                        if (piped) {
+                            id = pipeline->requestParking("V", t + 1).get();
+                        } else {
+                            std::lock_guard<std::mutex> lock(globalLock);
+                            id = ps.requestParking("V", t + 1);
+                        }
+                        auto t1 = std::chrono::steady_clock::now();
+                        if (piped) {
+                            pipeline->leaveParking(id).get();
+                        } else {
+                            std::lock_guard<std::mutex> lock(globalLock);
+                            ps.leaveParking(id);
+                        }
+                        auto t2 = std::chrono::steady_clock::now();
+                        latencies[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+                        latencies[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+                    }
+                });
+            }
+            for (auto& th : threads) th.join();
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::vector<long> all;
+            for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+            std::sort(all.begin(), all.end());
+            long p99 = all[all.size() * 99 / 100];
+            std::cout << "  " << threadCount << " threads, " << (piped ? "pipeline    " : "global mutex") << ": "
+                      << (long)(all.size() / secs) << " ops/s, p99 " << p99 / 1000.0 << " us";
+            if (piped) std::cout << ", " << (double)pipeline->getCommandsExecuted() / pipeline->getBatchesDrained() << " cmds/batch";
+            std::cout << "\n";
+        }
+    }
+}
+
+// Import a 10k batch across 8 zones, then time undoing all of it
+void benchmarkRollback() {
+    const int ops = 10000;
+    ParkingSystem ps = setupShardedCity(8, ops / 8);
+    ps.setLogging(false);
+    ps.setRollbackDepth(ops);
+    std::vector<ParkingRequestSpec> batch;
+    for (int i = 0; i < ops; ++i) batch.push_back({"B", i % 8 + 1});
+    ps.requestParkingBatch(batch);
+
+    auto start = std::chrono::steady_clock::now();
+    ps.rollbackOperations(ops);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\n--- Rollback of " << ops << " operations: " << ms << " ms ---\n";
+}
+
+// Park/leave pairs with no log, with group commit, and waiting for the fsync after every pair
+void benchmarkWal() {
+    const int pairs = 2000;
+    const std::string path = "bench_parking.wal";
+    const char* modes[] = {"in-memory", "group commit (256 records / 5 ms)", "synchronous (sync after each pair)"};
+
+    std::cout << "\n--- Write-ahead log (" << pairs << " park/leave pairs) ---\n";
+    for (int mode = 0; mode < 3; ++mode) {
+        std::remove(path.c_str());
+        ParkingSystem ps = setupShardedCity(1, 100);
+        ps.setLogging(false);
+        if (mode > 0) ps.openWriteAheadLog(path, 256, 5);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < pairs; ++i) {
+            ps.leaveParking(ps.requestParking("B", 1));
+            if (mode == 2) ps.syncWriteAheadLog();
+        }
+        ps.syncWriteAheadLog();
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  " << modes[mode] << ": " << (long)(pairs / sec) << " pairs/s\n";
+    }
+    std::remove(path.c_str());
+}
+
+// Restart of a million-slot, half-full city: assembly plus full log replay vs checkpoint image plus log tail
+void benchmarkCheckpoint() {
+    const int zones = 100;
+    const int perZone = 10000;
+    const std::string wal = "bench_ckpt.wal";
+    const std::string fullLog = "bench_ckpt_full.wal";
+    const std::string image = "bench_ckpt.img";
+    for (const std::string& f : {wal, fullLog, image}) std::remove(f.c_str());
+
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::cout << "\n--- Startup of a " << zones * perZone << "-slot city, half full ---\n";
+    {
+        ParkingSystem ps = setupShardedCity(zones, perZone);
+        ps.setLogging(false);
+        ps.openWriteAheadLog(wal);
+        std::vector<ParkingRequestSpec> batch;
+        for (int i = 0; i < zones * perZone / 2; ++i) batch.push_back({"V" + std::to_string(i), i % zones + 1});
+        ps.requestParkingBatch(batch);
+        ps.syncWriteAheadLog();
+        copyFile(wal, fullLog);
+
+        auto start = std::chrono::steady_clock::now();
+        ps.writeCheckpoint(image);
+        std::cout << "  checkpoint write: " << msSince(start) << " ms, " << fileSize(image) / (1 << 20) << " MB\n";
+        for (int i = 0; i < 1000; ++i) ps.leaveParking(ps.requestParking("T", i % zones + 1));
+        ps.syncWriteAheadLog();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ParkingSystem ps = setupShardedCity(zones, perZone);
+        ps.setLogging(false);
+        ps.openWriteAheadLog(fullLog);
+        std::cout << "  assemble + replay full log: " << msSince(start) << " ms\n";
+    }
+    start = std::chrono::steady_clock::now();
+    {
+        ParkingSystem ps;
+        ps.setLogging(false);
+        ps.loadCheckpoint(image);
+        ps.openWriteAheadLog(wal);
+        std::cout << "  load image + replay tail: " << msSince(start) << " ms\n";
+    }
+    for (const std::string& f : {wal, fullLog, image}) std::remove(f.c_str());
+}
+
+// Online backup of a million-slot city while a writer keeps parking
+void benchmarkBackup() {
+    const int zones = 100;
+    const int perZone = 10000;
+    const std::string backup = "bench_backup.img";
+    ParkingSystem ps = setupShardedCity(zones, perZone);
+    ps.setLogging(false);
+    ps.enableConcurrency();
+    std::vector<ParkingRequestSpec> batch;
+    for (int i = 0; i < zones * perZone / 2; ++i) batch.push_back({"V" + std::to_string(i), i % zones + 1});
+    ps.requestParkingBatch(batch);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> pairs(0);
+    std::thread writer([&]() {
+        for (int i = 0; !stop; ++i, ++pairs) ps.leaveParking(ps.requestParking("W", i % zones + 1));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BackupStats stats;
+    long before = pairs;
+    ps.forkBackup(backup, stats);
+    long during = pairs - before;
+    stop = true;
+    writer.join();
+    std::cout << "\n--- Fork backup of a " << zones * perZone << "-slot city, half full ---\n"
+              << "  paused " << stats.pauseMs << " ms, " << stats.totalMs << " ms total, " << stats.imageBytes / (1 << 20)
+              << " MB image, " << stats.duplicatedKB << " KB copied-on-write, " << during << " park/leave pairs served meanwhile\n";
+    std::remove(backup.c_str());
+}
+
+// Full /api/data document as the server built it with iostreams, for comparison
+std::string dataJsonWithStreams(const StateSnapshot& snap, long epoch) {
+    std::stringstream ss;
+    ss << "{ \"version\": " << snap.getVersion() << ", \"epoch\": " << epoch << ", \"full\": true, \"zones\": [";
+    for (int z = 0; z < snap.getZoneCount(); ++z) {
+        ss << "{ \"id\": " << snap.getZoneId(z) << ", \"areas\": [";
+        for (int a = snap.getZoneAreaBegin(z); a < snap.getZoneAreaEnd(z); ++a) {
+            ss << "{ \"id\": " << snap.getAreaId(a) << ", \"slots\": [";
+            for (int s = snap.getAreaSlotBegin(a); s < snap.getAreaSlotEnd(a); ++s) {
+                ss << "{ \"id\": " << snap.getSlotId(s) << ", \"occupied\": " << (snap.isOccupied(s) ? "true" : "false") << " }";
+                if (s < snap.getAreaSlotEnd(a) - 1) ss << ",";
+            }
+            ss << "] }";
+            if (a < snap.getZoneAreaEnd(z) - 1) ss << ",";
+        }
+        ss << "] }";
+        if (z < snap.getZoneCount() - 1) ss << ",";
+    }
+    ss << "], \"requests\": [";
+    const auto& reqs = snap.getRequests();
+    for (size_t i = 0; i < reqs.size(); ++i) {
+        const ParkingRequest& r = reqs[i];
+        ss << "{ \"id\": " << r.getRequestId() << ", \"vehicleId\": \"" << r.getVehicleId() << "\""
+           << ", \"zoneId\": " << r.getRequestedZoneId() << ", \"slotId\": " << r.getAssignedSlotId()
+           << ", \"state\": \"" << r.getStateString() << "\"" << ", \"duration\": " << r.getDuration() << " }";
+        if (i < reqs.size() - 1) ss << ",";
+    }
+    ss << "] }";
+    return ss.str();
+}
+
+void benchmarkJson() {
+    const int zones = 100;
+    const int perZone = 10000;
+    ParkingSystem ps = setupShardedCity(zones, perZone);
+    ps.setLogging(false);
+    ps.setSnapshotOnCommit(true);
+    std::vector<ParkingRequestSpec> batch;
+    for (int i = 0; i < zones * perZone / 10; ++i) batch.push_back({"V" + std::to_string(i), i % zones + 1});
+    ps.requestParkingBatch(batch);
+    std::shared_ptr<const StateSnapshot> snap = ps.getSnapshot();
+
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::cout << "\n--- /api/data dump of a " << zones * perZone << "-slot city, " << batch.size() << " requests ---\n";
+    auto start = std::chrono::steady_clock::now();
+    std::string streamed = dataJsonWithStreams(*snap, 1);
+    double streamMs = msSince(start);
+
+    DataJsonCache cache(1);
+    std::string etag;
+    start = std::chrono::steady_clock::now();
+    std::shared_ptr<const std::string> written = cache.get(ps, *snap, etag);
+    double writerMs = msSince(start);
+    assert(*written == streamed);
+    std::cout << "  stringstream:  " << streamMs << " ms (" << streamed.size() / streamMs / 1000 << " MB/s)\n"
+              << "  JsonWriter:    " << writerMs << " ms (" << written->size() / writerMs / 1000 << " MB/s), "
+              << streamed.size() / (1 << 20) << " MB\n";
+
+    ps.requestParking("ONE", 1);
+    start = std::chrono::steady_clock::now();
+    cache.get(ps, *ps.getSnapshot(), etag);
+    std::cout << "  after one change (cached fragments): " << msSince(start) << " ms\n";
+}
+
+void benchmarkArchive() {
+    // A week of traffic, hour by hour: busier by day, stays of 1-8 hours, 5% cancelled, an archive pass
+    // per hour (what the Checkpointer does); the same week without archival for comparison
+    const int days = 7;
+    auto runWeek = [&](bool archival) {
+        ParkingSystem ps = setupShardedCity(50, 400);
+        ps.setLogging(false);
+        simulatedNow = 1700000000;
+        ps.setClock(simulatedClock);
+        RetentionPolicy retention;
+        if (archival) {
+            retention.hotSeconds = 3600;
+            retention.archiveSeconds = 3 * 86400;
+        }
+        ps.setRetention(retention);
+
+        std::vector<std::vector<int>> leavingAt(days * 24 + 9);
+        unsigned seed = 7;
+        double slowestPass = 0;
+        std::cout << (archival ? "  with archival (1 h hot, 3 days archived):\n" : "  without archival:\n");
+        for (int hour = 0; hour < days * 24; ++hour) {
+            simulatedNow += 3600;
+            for (int id : leavingAt[hour]) ps.leaveParking(id);
+            int arrivals = hour % 24 >= 7 && hour % 24 < 19 ? 4000 : 1000;
+            std::vector<ParkingRequestSpec> batch;
+            for (int i = 0; i < arrivals; ++i) {
+                seed = seed * 1103515245 + 12345;
+                batch.push_back({"CAR-" + std::to_string(seed % 50000), (int)(seed >> 8) % 50 + 1});
+            }
+            std::vector<int> ids = ps.requestParkingBatch(batch);
+            for (int id : ids) {
+                seed = seed * 1103515245 + 12345;
+                if ((seed >> 16) % 20 == 0) ps.cancelRequest(id);
+                else leavingAt[hour + 1 + (seed >> 8) % 8].push_back(id);
+            }
+            auto start = std::chrono::steady_clock::now();
+            ps.archiveRequests();
+            slowestPass = std::max(slowestPass, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            if (hour % 24 == 23) {
+                const std::vector<ParkingRequest>& hot = ps.getRequests();
+                const ColdArchive& cold = ps.getArchive();
+                std::cout << "    day " << hour / 24 + 1 << ": " << hot.size() << " hot requests, table "
+                          << hot.capacity() * sizeof(ParkingRequest) / 1024 << " KB; " << cold.getRecordCount()
+                          << " archived in " << cold.getByteCount() / 1024 << " KB ("
+                          << (cold.getRecordCount() ? (double)cold.getByteCount() / cold.getRecordCount() : 0.0)
+                          << " B each), " << cold.getDroppedCount() << " dropped\n";
+            }
+        }
+        if (archival) std::cout << "    slowest archive pass: " << slowestPass << " ms\n";
+    };
+    std::cout << "\n--- Request storage over a simulated week (20000 slots, " << sizeof(ParkingRequest) << " B per hot request) ---\n";
+    runWeek(true);
+    runWeek(false);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        benchmarkStrategies();
+        benchmarkConcurrency();
+        benchmarkPipeline();
+        benchmarkRollback();
+        benchmarkWal();
+        benchmarkCheckpoint();
+        benchmarkBackup();
+        benchmarkJson();
+        benchmarkArchive();
+        return 0;
+    }
+
+    testBitmapAcrossWords();
+    testFreeList();
+    testMultiHopFallback();
+    testBatchAllocation();
+    testConcurrentZones();
+    testLockFreeClaiming();
+    testCommandPipeline();
+    testSnapshots();
+    testRollbackHistory();
+    testLargeRollback();
+    testWriteAheadLog();
+    testCheckpoint();
+    testForkBackup();
+    testDeltaSync();
+    testEventHub();
+    testJsonWriter();
+    testRequestQueries();
+    testArchive();
+    testDataJsonCache();
+    runTests(AllocationStrategy::BITMAP);
+    runTests(AllocationStrategy::LINEAR_SCAN);
+    runTests(AllocationStrategy::FREE_LIST);
     return 0;
 }
@@ -5,51 +5,146 @@
 #include "ParkingSlot.h"
 #include "Vehicle.h"
 #include "ParkingRequest.h"
+#include "CommandPipeline.h"
+#include "Checkpointer.h"
+#include "SnapshotPublisher.h"
+#include "DataJsonCache.h"
 #include <iostream>
 #include <string>
-#include <sstream>
+#include <chrono>
 
-// Helper to manual serialization of JSON
-// In a real project we would use nlohmann/json, but to avoid more deps we do simple string building
-std::string toJson(const std::string& key, const std::string& value) {
-    return "\"" + key + "\": \"" + value + "\"";
+// Responses are built with a JsonWriter per handler thread, so its buffer is reused across requests
+// In a real project we would use nlohmann/json, but to avoid more deps we write the JSON by hand
+JsonWriter& responseWriter() {
+    thread_local JsonWriter json;
+    json.clear();
+    return json;
 }
 
-std::string toJson(const std::string& key, int value) {
-    return "\"" + key + "\": " + std::to_string(value);
+void setJson(httplib::Response& res, const JsonWriter& json) {
+    res.set_content(json.data(), json.size(), "application/json");
+}
+
+// Minimal parser for the batch endpoint body: [{"vehicleId": "V1", "zoneId": 1}, ...]
+// Only string and integer values are understood; anything else fails the whole batch.
+bool parseBatchBody(const std::string& body, std::vector<ParkingRequestSpec>& out) {
+    size_t i = 0;
+    auto skipSpace = [&]() { while (i < body.size() && isspace((unsigned char)body[i])) i++; };
+    auto expect = [&](char c) { skipSpace(); if (i < body.size() && body[i] == c) { i++; return true; } return false; };
+    auto parseString = [&](std::string& str) {
+        if (!expect('"')) return false;
+        str.clear();
+        while (i < body.size() && body[i] != '"') {
+            if (body[i] == '\\' && i + 1 < body.size()) i++; // Keep the escaped character as-is
+            str += body[i++];
+        }
+        return expect('"');
+    };
+    auto parseInt = [&](int& value) {
+        skipSpace();
+        size_t start = i;
+        if (i < body.size() && body[i] == '-') i++;
+        while (i < body.size() && isdigit((unsigned char)body[i])) i++;
+        if (i == start || (i == start + 1 && body[start] == '-')) return false;
+        value = std::stoi(body.substr(start, i - start));
+        return true;
+    };
+
+    if (!expect('[')) return false;
+    if (expect(']')) return true;
+    do {
+        if (!expect('{')) return false;
+        ParkingRequestSpec spec = {"", 0};
+        bool hasVehicle = false, hasZone = false;
+        do {
+            std::string key;
+            if (!parseString(key) || !expect(':')) return false;
+            if (key == "vehicleId") hasVehicle = parseString(spec.vehicleId);
+            else if (key == "zoneId") hasZone = parseInt(spec.zoneId);
+            else return false;
+            if ((key == "vehicleId" && !hasVehicle) || (key == "zoneId" && !hasZone)) return false;
+        } while (expect(','));
+        if (!expect('}') || !hasVehicle || !hasZone) return false;
+        out.push_back(spec);
+    } while (expect(','));
+    return expect(']');
+}
+
+// "ALLOCATED,OCCUPIED" -> states; false on an unknown name
+bool parseStates(const std::string& list, std::vector<RequestState>& out) {
+    static const RequestState all[] = {RequestState::REQUESTED, RequestState::ALLOCATED, RequestState::OCCUPIED,
+                                       RequestState::RELEASED, RequestState::CANCELLED};
+    static const char* names[] = {"REQUESTED", "ALLOCATED", "OCCUPIED", "RELEASED", "CANCELLED"};
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        std::string name = list.substr(start, comma - start);
+        size_t i = 0;
+        while (i < 5 && name != names[i]) i++;
+        if (i == 5) return false;
+        out.push_back(all[i]);
+        start = comma + 1;
+    }
+    return true;
 }
 
 // Setup the same city as main.cpp
 ParkingSystem setupCity() {
     ParkingSystem ps;
     // Zone 1
-    Zone z1(1);
-    ParkingArea a1(101);
-    a1.addSlot(ParkingSlot(1, 1));
-    a1.addSlot(ParkingSlot(2, 1));
-    z1.addParkingArea(a1);
+    Zone z1 = ps.addZone(1);
+    ParkingArea a1 = z1.addParkingArea(101);
+    a1.addSlot(1);
+    a1.addSlot(2);
     z1.addAdjacentZone(2);
     // Zone 2
-    Zone z2(2);
-    ParkingArea a2(201);
-    a2.addSlot(ParkingSlot(3, 2));
-    z2.addParkingArea(a2);
+    Zone z2 = ps.addZone(2);
+    ParkingArea a2 = z2.addParkingArea(201);
+    a2.addSlot(3);
     z2.addAdjacentZone(1);
     // Zone 3
-    Zone z3(3);
-    ParkingArea a3(301);
-    a3.addSlot(ParkingSlot(4, 3));
-    z3.addParkingArea(a3);
-
-    ps.addZone(z1);
-    ps.addZone(z2);
-    ps.addZone(z3);
+    Zone z3 = ps.addZone(3);
+    ParkingArea a3 = z3.addParkingArea(301);
+    a3.addSlot(4);
     return ps;
 }
 
-int main() {
-    ParkingSystem ps = setupCity();
+// The last checkpoint image if there is one, else the hard-coded city
+ParkingSystem loadCity() {
+    ParkingSystem ps;
+    if (ps.loadCheckpoint("parking.img")) return ps;
+    return setupCity();
+}
+
+int main(int argc, char* argv[]) {
+    ParkingSystem ps = loadCity();
+    ps.openWriteAheadLog("parking.wal"); // Replays what the image doesn't cover, then logs every change
+    // Every open /api/events stream occupies a worker, so the pool is sized for them and capped below it
+    const size_t workerThreads = 64;
+    const size_t maxEventStreams = 48;
+    std::shared_ptr<EventHub> hub = std::make_shared<EventHub>(maxEventStreams); // Feeds /api/events
+    ps.setEventHub(hub);
+    ps.enableConcurrency(); // Handlers run on httplib's thread pool
+    // Cutting a snapshot copies the request table behind the commit gate, so it is done every 100 ms
+    // rather than per write, where it would serialize all writers. /api/events pushes writes immediately.
+    SnapshotPublisher publisher(ps, 100);
+    RetentionPolicy retention;
+    retention.hotSeconds = 3600;          // Finished requests stay on the dashboard for an hour
+    retention.archiveSeconds = 7 * 86400; // and in the cold archive (analytics) for a week
+    ps.setRetention(retention);
+    Checkpointer checkpointer(ps, "parking.img", 60000); // Restarts replay at most a minute of log; archives every minute
+
+    // --pipeline: mutations go through one writer thread instead of contending on locks.
+    // The system stays in concurrent mode so readers (/api/data) remain safe; the writer's locks are uncontended.
+    std::unique_ptr<CommandPipeline> pipeline;
+    if (argc > 1 && std::string(argv[1]) == "--pipeline") {
+        ps.setLogging(false);
+        pipeline.reset(new CommandPipeline(ps, 4096, 0));
+        std::cout << "Mutations go through the single-writer pipeline" << std::endl;
+    }
     httplib::Server svr;
+    svr.new_task_queue = [workerThreads] { return new httplib::ThreadPool(workerThreads); };
 
     std::cout << "Starting Parking Server on port 8080..." << std::endl;
 
@@ -66,45 +161,132 @@ int main() {
     });
 
     // GET /api/data - Dump entire state
-    svr.Get("/api/data", [&](const httplib::Request&, httplib::Response& res) {
-        std::stringstream ss;
-        ss << "{ \"zones\": [";
-        const auto& zones = ps.getZones();
-        for(size_t i=0; i<zones.size(); ++i) {
-            const auto& z = zones[i];
-            ss << "{ \"id\": " << z.getZoneId() << ", \"areas\": [";
-            const auto& areas = z.getParkingAreas();
-            for(size_t j=0; j<areas.size(); ++j) {
-                const auto& a = areas[j];
-                ss << "{ \"id\": " << a.getAreaId() << ", \"slots\": [";
-                const auto& slots = a.getSlots();
-                for(size_t k=0; k<slots.size(); ++k) {
-                    const auto& s = slots[k];
-                    ss << "{ \"id\": " << s.getSlotId() 
-                       << ", \"occupied\": " << (s.isOccupied() ? "true" : "false") << " }";
-                    if(k < slots.size()-1) ss << ",";
-                }
-                ss << "] }";
-                if(j < areas.size()-1) ss << ",";
+    // GET /api/data?since=<version>&epoch=<epoch> - Only the slots and requests changed since that version,
+    // or the entire state with "full": true if the client is too far behind or from another server run.
+    // Full documents carry an ETag; If-None-Match with the current one gets 304.
+    // Small cities are served from DataJsonCache. Bigger ones are never built as one string: each download
+    // renders its pinned snapshot zone by zone and request by request into chunks of about dataChunkBytes.
+    const size_t dataChunkBytes = 64 * 1024;
+    const long epoch = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    DataJsonCache dataCache(epoch);
+    svr.Get("/api/data", [&](const httplib::Request& req, httplib::Response& res) {
+        // Immutable snapshot: serialization never holds a lock the writers need
+        std::shared_ptr<const StateSnapshot> snap = ps.getSnapshot();
+
+        std::vector<int> slots;
+        std::vector<int> changed;
+        bool sameRun = !req.has_param("epoch") || std::stol(req.get_param_value("epoch")) == epoch;
+        if (req.has_param("since") && sameRun && ps.getChangesSince(std::stoul(req.get_param_value("since")), *snap, slots, changed)) {
+            JsonWriter& json = responseWriter();
+            json.raw("{ ").key("version").number(snap->getVersion()).raw(", ").key("epoch").number(epoch)
+                .raw(", ").key("full").boolean(false).raw(", ").key("slots").raw("[");
+            for (size_t i = 0; i < slots.size(); ++i) {
+                if (i > 0) json.raw(",");
+                writeSlotJson(json, *snap, slots[i]);
+            }
+            json.raw("], ").key("requests").raw("[");
+            for (size_t i = 0; i < changed.size(); ++i) {
+                if (i > 0) json.raw(",");
+                writeRequestJson(json, snap->getRequests()[changed[i]]);
             }
-            ss << "] }";
-            if(i < zones.size()-1) ss << ",";
+            json.raw("] }");
+            setJson(res, json);
+            return;
+        }
+
+        // A slot renders to about 36 bytes and a request to about 110
+        bool small = (size_t)snap->getSlotCount() * 36 + snap->getRequests().size() * 110 <= dataChunkBytes;
+        std::string etag;
+        std::shared_ptr<const std::string> doc;
+        if (small) doc = dataCache.get(ps, *snap, etag);
+        else etag = dataJsonEtag(epoch, snap->getVersion());
+        res.set_header("ETag", etag);
+        if (req.get_header_value("If-None-Match") == etag) {
+            res.status = 304;
+            return;
         }
-        ss << "], \"requests\": [";
-        const auto& reqs = ps.getRequests();
-        for(size_t i=0; i<reqs.size(); ++i) {
-            const auto& r = reqs[i];
-            ss << "{ \"id\": " << r.getRequestId()
-               << ", \"vehicleId\": \"" << r.getVehicleId() << "\""
-               << ", \"zoneId\": " << r.getRequestedZoneId()
-               << ", \"slotId\": " << r.getAssignedSlotId()
-               << ", \"state\": \"" << r.getStateString() << "\""
-               << ", \"duration\": " << r.getDuration() << " }";
-            if(i < reqs.size()-1) ss << ",";
+        if (small) {
+            res.set_content(*doc, "application/json");
+            return;
         }
-        ss << "] }";
-        
-        res.set_content(ss.str(), "application/json");
+        std::shared_ptr<DataJsonStream> stream = std::make_shared<DataJsonStream>(snap, epoch);
+        res.set_chunked_content_provider("application/json", [stream, dataChunkBytes](size_t, httplib::DataSink& sink) {
+            if (!stream->next(dataChunkBytes)) {
+                sink.done();
+                return true;
+            }
+            return sink.write(stream->chunk().data(), stream->chunk().size());
+        });
+    });
+
+    // GET /api/requests?state=ALLOCATED,OCCUPIED&zone=1&assignedZone=2&vehicle=V1&from=<unix s>&to=<unix s>&after=<id>&limit=100
+    // Matching requests oldest first, one page at a time: { "requests": [...], "next": <id for after=> | null }.
+    // Served from indexes, so a page costs about its own size however long the history is.
+    svr.Get("/api/requests", [&](const httplib::Request& req, httplib::Response& res) {
+        RequestQuery query;
+        if (req.has_param("state") && !parseStates(req.get_param_value("state"), query.states)) {
+            res.status = 400;
+            res.set_content("Unknown state", "text/plain");
+            return;
+        }
+        if (req.has_param("zone")) query.requestedZoneId = std::stoi(req.get_param_value("zone"));
+        if (req.has_param("assignedZone")) query.assignedZoneId = std::stoi(req.get_param_value("assignedZone"));
+        if (req.has_param("vehicle")) query.vehicleId = req.get_param_value("vehicle");
+        if (req.has_param("from")) query.from = (time_t)std::stol(req.get_param_value("from"));
+        if (req.has_param("to")) query.to = (time_t)std::stol(req.get_param_value("to"));
+        if (req.has_param("after")) query.afterRequestId = std::stoi(req.get_param_value("after"));
+        if (req.has_param("limit")) query.limit = std::max(1, std::min(1000, std::stoi(req.get_param_value("limit"))));
+
+        std::vector<ParkingRequest> page;
+        int next;
+        if (!ps.queryRequests(query, page, next)) {
+            res.status = 400;
+            res.set_content("Unknown cursor", "text/plain");
+            return;
+        }
+        JsonWriter& json = responseWriter();
+        json.raw("{ ").key("requests").raw("[");
+        for (size_t i = 0; i < page.size(); ++i) {
+            if (i > 0) json.raw(",");
+            writeRequestJson(json, page[i]);
+        }
+        json.raw("], ").key("next");
+        if (next == -1) json.raw("null"); else json.number(next);
+        json.raw(" }");
+        setJson(res, json);
+    });
+
+    // GET /api/events - Server-sent events, one per request change as it happens:
+    // data: { "seq": 12, "type": "allocate"|"cancel"|"leave"|"rollback", "request": {...} }
+    // A client that falls 256 events behind gets "event: resync" and should re-fetch /api/data.
+    // Past maxEventStreams the answer is 503 and the client keeps polling.
+    svr.Get("/api/events", [&](const httplib::Request&, httplib::Response& res) {
+        std::shared_ptr<EventSubscription> subscription = hub->subscribe(256);
+        if (!subscription) {
+            res.status = 503;
+            return;
+        }
+        res.set_header("Cache-Control", "no-cache");
+        res.set_chunked_content_provider("text/event-stream",
+            [hub, subscription](size_t, httplib::DataSink& sink) {
+                std::vector<std::shared_ptr<const ParkingEvent>> events;
+                EventHub::WaitResult result = hub->wait(*subscription, events, 15000);
+                if (result == EventHub::CLOSED) {
+                    sink.done();
+                    return true;
+                }
+                JsonWriter& chunk = responseWriter();
+                if (result == EventHub::TIMEOUT) chunk.raw(": keep-alive\n\n"); // Also how a closed connection is noticed
+                if (result == EventHub::RESYNC) chunk.raw("event: resync\ndata: {}\n\n");
+                for (const auto& event : events) {
+                    chunk.raw("data: { ").key("seq").number(event->sequence).raw(", ").key("type").raw("\"").raw(event->type)
+                         .raw("\", ").key("request");
+                    writeRequestJson(chunk, event->request);
+                    chunk.raw(" }\n\n");
+                }
+                return sink.write(chunk.data(), chunk.size());
+            },
+            [hub, subscription](bool) { hub->unsubscribe(subscription); });
     });
 
     // POST /api/request - Body: vehicleId=V1&zoneId=1
@@ -116,8 +298,30 @@ int main() {
         }
         std::string vId = req.get_param_value("vehicleId");
         int zId = std::stoi(req.get_param_value("zoneId"));
-        int rId = ps.requestParking(vId, zId);
-        res.set_content("{\"requestId\": " + std::to_string(rId) + "}", "application/json");
+        int rId = pipeline ? pipeline->requestParking(vId, zId).get() : ps.requestParking(vId, zId);
+        JsonWriter& json = responseWriter();
+        json.raw("{").key("requestId").number(rId).raw("}");
+        setJson(res, json);
+    });
+
+    // POST /api/request/batch - JSON body: [{"vehicleId": "V1", "zoneId": 1}, ...]
+    svr.Post("/api/request/batch", [&](const httplib::Request& req, httplib::Response& res) {
+        std::vector<ParkingRequestSpec> batch;
+        if (!parseBatchBody(req.body, batch)) {
+             res.status = 400;
+             res.set_content("Expected a JSON array of {vehicleId, zoneId} objects", "text/plain");
+             return;
+        }
+        std::vector<int> ids = pipeline ? pipeline->requestParkingBatch(std::move(batch)).get() : ps.requestParkingBatch(batch);
+
+        JsonWriter& json = responseWriter();
+        json.raw("{").key("requestIds").raw("[");
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (i > 0) json.raw(", ");
+            json.number(ids[i]);
+        }
+        json.raw("]}");
+        setJson(res, json);
     });
 
     // POST /api/leave - Body: requestId=1
@@ -127,8 +331,10 @@ int main() {
              return;
         }
         int rId = std::stoi(req.get_param_value("requestId"));
-        bool success = ps.leaveParking(rId);
-        res.set_content(success ? "{\"status\": \"left\"}" : "{\"status\": \"failed\"}", "application/json");
+        bool success = pipeline ? pipeline->leaveParking(rId).get() != 0 : ps.leaveParking(rId);
+        JsonWriter& json = responseWriter();
+        json.raw("{").key("status").string(success ? "left" : "failed").raw("}");
+        setJson(res, json);
     });
 
     // POST /api/cancel - Body: requestId=1
@@ -138,16 +344,40 @@ int main() {
              return;
         }
         int rId = std::stoi(req.get_param_value("requestId"));
-        bool success = ps.cancelRequest(rId);
-        res.set_content(success ? "{\"status\": \"cancelled\"}" : "{\"status\": \"failed\"}", "application/json");
+        bool success = pipeline ? pipeline->cancelRequest(rId).get() != 0 : ps.cancelRequest(rId);
+        JsonWriter& json = responseWriter();
+        json.raw("{").key("status").string(success ? "cancelled" : "failed").raw("}");
+        setJson(res, json);
     });
 
     // POST /api/rollback - Body: k=1
     svr.Post("/api/rollback", [&](const httplib::Request& req, httplib::Response& res) {
          int k = 1;
          if(req.has_param("k")) k = std::stoi(req.get_param_value("k"));
-         ps.rollbackOperations(k);
-         res.set_content("{\"status\": \"rolled_back\"}", "application/json");
+         if (pipeline) pipeline->rollbackOperations(k).get(); else ps.rollbackOperations(k);
+         JsonWriter& json = responseWriter();
+         json.raw("{").key("status").string("rolled_back").raw("}");
+         setJson(res, json);
+    });
+
+    // POST /api/admin/backup - Point-in-time copy to backup.img, written by a forked child
+    // while this process keeps serving; reports the pause and the memory duplicated meanwhile.
+    // 409 while another backup is running.
+    svr.Post("/api/admin/backup", [&](const httplib::Request&, httplib::Response& res) {
+        BackupStats stats;
+        bool ok = ps.forkBackup("backup.img", stats);
+        JsonWriter& json = responseWriter();
+        if (stats.busy) {
+            json.raw("{ ").key("status").string("busy").raw(", ").key("error").string("A backup is already running").raw(" }");
+            res.status = 409;
+            setJson(res, json);
+            return;
+        }
+        json.raw("{ ").key("status").string(ok ? "ok" : "failed").raw(", ").key("path").string("backup.img")
+            .raw(", ").key("pauseMs").number(stats.pauseMs).raw(", ").key("totalMs").number(stats.totalMs)
+            .raw(", ").key("bytes").number(stats.imageBytes).raw(", ").key("duplicatedKB").number(stats.duplicatedKB).raw(" }");
+        if (!ok) res.status = 500;
+        setJson(res, json);
     });
 
     svr.listen("0.0.0.0", 8080);